@@ -0,0 +1,42 @@
+#ifndef GKL_CONST_FRAMES_H_
+#define GKL_CONST_FRAMES_H_
+
+#include <stdint.h>
+
+/*
+ * Кадры команд без данных (02 00 ADDR CMD XOR) на этапе компиляции.
+ * XOR такого кадра — 0x00 ^ ADDR ^ CMD, поэтому таблица целиком получается
+ * константным инициализатором и ложится в .rodata (флеш), откуда её читает
+ * DMA передачи. Адрес вне 1..32 и команда не 'A'..'Z' — ошибка компиляции
+ * (массив отрицательного размера), длина кадра проверяется static_assert.
+ *
+ *   static const uint8_t polls[32][GKL_CONST_FRAME_LEN] = GKL_CONST_FRAMES_ALL('S');
+ */
+
+#define GKL_CONST_FRAME_LEN     5u   /* SYN + ADDR_HI + ADDR_LO + CMD + XOR */
+
+/* Значение x, если cond истинно; иначе sizeof(char[-1]) не компилируется */
+#define GKL_CT_CHECK(cond, x)   ((x) + 0u * sizeof(char[(cond) ? 1 : -1]))
+
+#define GKL_CT_ADDR(a)          ((uint8_t)GKL_CT_CHECK((a) >= 1 && (a) <= 32, (a)))
+#define GKL_CT_CMD(c)           ((uint8_t)GKL_CT_CHECK((c) >= 'A' && (c) <= 'Z', (c)))
+
+#define GKL_CONST_FRAME(a, c) \
+    { 0x02u, 0x00u, GKL_CT_ADDR(a), GKL_CT_CMD(c), (uint8_t)(0x00u ^ (uint8_t)(a) ^ (uint8_t)(c)) }
+
+_Static_assert(sizeof((const uint8_t[])GKL_CONST_FRAME(1, 'S')) == GKL_CONST_FRAME_LEN,
+               "GKL_CONST_FRAME: длина кадра не совпадает с GKL_CONST_FRAME_LEN");
+
+/* Одна команда для всех адресов 1..32: индекс [адрес - 1] */
+#define GKL_CONST_FRAMES_ALL(c) { \
+    GKL_CONST_FRAME( 1, c), GKL_CONST_FRAME( 2, c), GKL_CONST_FRAME( 3, c), GKL_CONST_FRAME( 4, c), \
+    GKL_CONST_FRAME( 5, c), GKL_CONST_FRAME( 6, c), GKL_CONST_FRAME( 7, c), GKL_CONST_FRAME( 8, c), \
+    GKL_CONST_FRAME( 9, c), GKL_CONST_FRAME(10, c), GKL_CONST_FRAME(11, c), GKL_CONST_FRAME(12, c), \
+    GKL_CONST_FRAME(13, c), GKL_CONST_FRAME(14, c), GKL_CONST_FRAME(15, c), GKL_CONST_FRAME(16, c), \
+    GKL_CONST_FRAME(17, c), GKL_CONST_FRAME(18, c), GKL_CONST_FRAME(19, c), GKL_CONST_FRAME(20, c), \
+    GKL_CONST_FRAME(21, c), GKL_CONST_FRAME(22, c), GKL_CONST_FRAME(23, c), GKL_CONST_FRAME(24, c), \
+    GKL_CONST_FRAME(25, c), GKL_CONST_FRAME(26, c), GKL_CONST_FRAME(27, c), GKL_CONST_FRAME(28, c), \
+    GKL_CONST_FRAME(29, c), GKL_CONST_FRAME(30, c), GKL_CONST_FRAME(31, c), GKL_CONST_FRAME(32, c)  \
+}
+
+#endif /* GKL_CONST_FRAMES_H_ */
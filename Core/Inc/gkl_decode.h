@@ -0,0 +1,101 @@
+#ifndef GKL_DECODE_H_
+#define GKL_DECODE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Разбор поля данных ответов ТРК в числа. Без malloc и без float:
+ * объём — в сотых литра (0.01 л), деньги и цена — в копейках.
+ * Поля ASCII-цифр ('0'..'9'); нецифра в числовом поле — ответ битый.
+ */
+
+/* 'S' / 'D': status + nozzle */
+typedef struct {
+    uint8_t  status;        /* gkl_trk_status_t */
+    uint8_t  nozzle;        /* ASCII-номер пистолета, как пришёл */
+} GKL_StatusReply;
+
+/* 'L': nozzle + id + status + ';' + volume(6) */
+typedef struct {
+    uint8_t  nozzle;
+    uint8_t  id;
+    uint8_t  status;
+    uint32_t volume_cl;     /* налито, 0.01 л */
+} GKL_VolumeReply;
+
+/* 'R': nozzle + id + status + ';' + money(6) */
+typedef struct {
+    uint8_t  nozzle;
+    uint8_t  id;
+    uint8_t  status;
+    uint32_t money_kop;     /* на сумму, коп. */
+} GKL_MoneyReply;
+
+/* 'T': nozzle + ';' + volume(10) + ';' + money(9) — суммарные счётчики */
+typedef struct {
+    uint8_t  nozzle;
+    uint64_t volume_cl;
+    uint64_t money_kop;
+} GKL_TotalsReply;
+
+/* 'C': nozzle + ';' + price(6) + ';' + grade(2) */
+typedef struct {
+    uint8_t  nozzle;
+    uint32_t price_kop;     /* коп. за литр */
+    uint8_t  grade;         /* код топлива 0..99 */
+} GKL_PriceReply;
+
+/* 'Z': nozzle + dose(5) — подтверждение заданной дозы */
+typedef struct {
+    uint8_t  nozzle;
+    uint32_t dose;          /* как задавали: 0.01 л или коп. — зависит от команды */
+} GKL_PresetReply;
+
+/* Разобранный ответ любого типа */
+typedef struct {
+    uint8_t  slave_addr;
+    uint8_t  cmd;
+    union {
+        GKL_StatusReply status;   /* 'S', 'D' */
+        GKL_VolumeReply volume;   /* 'L' */
+        GKL_MoneyReply  money;    /* 'R' */
+        GKL_TotalsReply totals;   /* 'T' */
+        GKL_PriceReply  price;    /* 'C' */
+        GKL_PresetReply preset;   /* 'Z' */
+    } u;
+} GKL_Reply;
+
+/**
+ * @brief ASCII-цифры в число (без знака, без разделителей).
+ * @return false, если встретилась нецифра или len == 0.
+ */
+bool gkl_ascii_to_u32(const uint8_t* s, size_t len, uint32_t* out);
+bool gkl_ascii_to_u64(const uint8_t* s, size_t len, uint64_t* out);
+
+/* Разборщики полей для таблиц диалектов (gkl_dialect.h). Смещения — как у Censtar,
+   поэтому каждый принимает только свою длину (2/10/10/22/11/6), иначе false */
+bool gkl_decode_status(const uint8_t* data, size_t len, GKL_Reply* out);   /* 'S', 'D' */
+bool gkl_decode_volume(const uint8_t* data, size_t len, GKL_Reply* out);   /* 'L' */
+bool gkl_decode_money(const uint8_t* data, size_t len, GKL_Reply* out);    /* 'R' */
+bool gkl_decode_totals(const uint8_t* data, size_t len, GKL_Reply* out);   /* 'T' */
+bool gkl_decode_price(const uint8_t* data, size_t len, GKL_Reply* out);    /* 'C' */
+bool gkl_decode_preset(const uint8_t* data, size_t len, GKL_Reply* out);   /* 'Z' */
+
+/**
+ * @brief Разбирает поле данных ответа (диалект Censtar).
+ * @param slave_addr Адрес из кадра.
+ * @param cmd Код ответа ('S', 'L', 'R', 'T', 'C', 'Z', 'D').
+ * @param data Поле данных (без SYN/адреса/команды/XOR).
+ * @param len Его длина — должна совпасть с длиной для этого кода.
+ * @return true, если ответ известен и все поля корректны.
+ */
+bool GKL_Decode(uint8_t slave_addr, uint8_t cmd, const uint8_t* data, size_t len, GKL_Reply* out);
+
+struct gkl_dialect_s;
+/** @brief То же по таблице диалекта: длина и разборщик — из неё. */
+bool GKL_DecodeWith(const struct gkl_dialect_s* dialect, uint8_t slave_addr, uint8_t cmd,
+                    const uint8_t* data, size_t len, GKL_Reply* out);
+
+#endif /* GKL_DECODE_H_ */
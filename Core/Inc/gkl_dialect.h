@@ -0,0 +1,57 @@
+#ifndef GKL_DIALECT_H_
+#define GKL_DIALECT_H_
+
+#include "gkl_decode.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Диалект протокола — константная таблица ответов по коду команды:
+ * длина поля данных и разборщик (он же проверяет поля). Индекс — сам код
+ * ('A'..'Z'), без цепочки switch: парсер на байт заголовка тратит одно
+ * чтение из таблицы при любом числе диалектов.
+ *
+ * Новая прошивка ТРК с другими длинами/полями — новая таблица:
+ *   const gkl_dialect_t GKL_DIALECT_MY = { "my-fw", { ['S' - 'A'] = { 2, gkl_decode_status }, ... } };
+ * и .dialect = &GKL_DIALECT_MY в строке линии (trk_line_cfg_t). Готовые
+ * gkl_decode_* подходят только при тех же длинах, что у Censtar; поле другой
+ * длины — свой разборщик (чужую длину штатные отвергают, а не читают мимо).
+ */
+
+#define GKL_DIALECT_CMD_FIRST   'A'
+#define GKL_DIALECT_CMD_COUNT   ('Z' - 'A' + 1)
+
+/* Разбор поля данных в out->u. len — data_len из таблицы: разборщик с другой
+   раскладкой полей обязан её отвергнуть. false — поля битые или длина не та */
+typedef bool (*gkl_reply_decoder_t)(const uint8_t* data, size_t len, GKL_Reply* out);
+
+typedef struct {
+    uint8_t             data_len;   /* 0 — такого ответа в диалекте нет */
+    gkl_reply_decoder_t decode;     /* NULL — кадр принимается, но не разбирается */
+} gkl_reply_desc_t;
+
+typedef struct gkl_dialect_s {
+    const char*         name;
+    gkl_reply_desc_t    reply[GKL_DIALECT_CMD_COUNT];
+} gkl_dialect_t;
+
+/* Штатная прошивка Censtar: S/D 2, L/R 10, T 22, C 11, Z 6 */
+extern const gkl_dialect_t GKL_DIALECT_CENSTAR;
+
+/* Описание ответа cmd или NULL (нет в диалекте / не буква) */
+static inline const gkl_reply_desc_t* GKL_Dialect_Reply(const gkl_dialect_t* d, uint8_t cmd)
+{
+    uint8_t i = (uint8_t)(cmd - GKL_DIALECT_CMD_FIRST);
+    if (i >= GKL_DIALECT_CMD_COUNT || d->reply[i].data_len == 0) return NULL;
+    return &d->reply[i];
+}
+
+/* Длина поля данных ответа cmd, 0 — неизвестная команда */
+static inline size_t GKL_Dialect_DataLen(const gkl_dialect_t* d, uint8_t cmd)
+{
+    uint8_t i = (uint8_t)(cmd - GKL_DIALECT_CMD_FIRST);
+    return (i < GKL_DIALECT_CMD_COUNT) ? d->reply[i].data_len : 0u;
+}
+
+#endif /* GKL_DIALECT_H_ */
@@ -0,0 +1,66 @@
+#ifndef GKL_ENCODE_H_
+#define GKL_ENCODE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Кадры команд для ТРК. Команды без данных собраны компилятором в таблицу во
+ * флеше (gkl_const_frames.h): их кадр — указатель на .rodata, его можно отдавать
+ * DMA без копирования. Для команд с данными GKL_Encode_Init один раз собирает
+ * шаблоны по всем адресам с нулями в полях; при заполнении XOR правится по
+ * изменённым байтам, без пересчёта по всему кадру.
+ * Числа — как в ответах: объём в 0.01 л, деньги и цена в копейках.
+ */
+
+#define GKL_CMD_FRAME_MAX   16u   /* самый длинный кадр команды с запасом */
+
+/* Команды ведущего (контроллера). Сначала — без данных (до GKL_CMD_TOTALS) */
+typedef enum {
+    GKL_CMD_STATUS = 0,     /* 'S' — статус,                       ответ 'S' */
+    GKL_CMD_STOP,           /* 'B' — стоп налива,                  ответ 'S' */
+    GKL_CMD_AUTHORIZE,      /* 'G' — пуск по заданной дозе,        ответ 'S' */
+    GKL_CMD_RESET,          /* 'N' — сброс итога, ТРК снова свободна, ответ 'D' */
+    GKL_CMD_VOLUME,         /* 'L' — налитый объём,                ответ 'L' */
+    GKL_CMD_MONEY,          /* 'R' — налито на сумму,              ответ 'R' */
+    GKL_CMD_TOTALS,         /* 'T' + nozzle — суммарные счётчики,  ответ 'T' */
+    GKL_CMD_PRICE,          /* 'C' + nozzle — цена,                ответ 'C' */
+    GKL_CMD_PRESET_VOLUME,  /* 'V' + nozzle + dose(5), 0.01 л,     ответ 'Z' */
+    GKL_CMD_PRESET_MONEY,   /* 'M' + nozzle + dose(5), коп.,       ответ 'Z' */
+    GKL_CMD_SET_PRICE,      /* 'P' + nozzle + ';' + price(6), коп., ответ 'C' */
+    GKL_CMD_COUNT
+} gkl_cmd_id_t;
+
+/** @brief Собирает шаблоны команд с данными для адресов 1..32. Вызвать один раз до первой отправки. */
+void GKL_Encode_Init(void);
+
+/** @brief ASCII-код команды ('S', 'B', ...), 0 — нет такой. */
+uint8_t GKL_Encode_CmdCode(gkl_cmd_id_t id);
+
+/**
+ * @brief Готовый кадр-шаблон: без данных — во флеше, с данными — в ОЗУ, с нулями в полях.
+ * @param len Сюда пишется длина кадра.
+ * @return NULL, если адрес вне 1..32 или команды нет.
+ */
+const uint8_t* GKL_Encode_Template(uint8_t slave_addr, gkl_cmd_id_t id, size_t* len);
+
+/**
+ * @brief Команда без параметров ('S', 'B', 'G', 'N', 'L', 'R').
+ * @return Длина кадра или 0 (адрес вне диапазона, у команды есть данные, мал буфер).
+ */
+size_t GKL_Encode(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t* out, size_t cap);
+
+/** @brief 'T' / 'C' для пистолета nozzle (1..9). */
+size_t GKL_Encode_Nozzle(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t nozzle,
+                         uint8_t* out, size_t cap);
+
+/** @brief 'V' / 'M': доза 0..99999 (0.01 л или коп.) на пистолет nozzle (1..9). */
+size_t GKL_Encode_Preset(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t nozzle, uint32_t dose,
+                         uint8_t* out, size_t cap);
+
+/** @brief 'P': цена 0..999999 коп. за литр на пистолет nozzle (1..9). */
+size_t GKL_Encode_SetPrice(uint8_t slave_addr, uint8_t nozzle, uint32_t price_kop,
+                           uint8_t* out, size_t cap);
+
+#endif /* GKL_ENCODE_H_ */
@@ -4,6 +4,15 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/* Состояние ТРК — первый байт данных ответа 'S' (ASCII), второй — номер пистолета */
+typedef enum {
+    GKL_TRK_OFF        = '0', /* ТРК выключена, пистолет повешен */
+    GKL_TRK_NOZZLE_UP  = '1', /* пистолет снят */
+    GKL_TRK_AUTHORIZED = '2', /* доза задана, налив разрешён */
+    GKL_TRK_FUELING    = '3', /* идёт налив */
+    GKL_TRK_FINISHED   = '4', /* налив окончен, итог ещё не считан */
+} gkl_trk_status_t;
+
 /**
  * @brief Рассчитывает 1-байтовую XOR контрольную сумму.
  * @param bytes Указатель на данные.
@@ -6,6 +6,8 @@
 #include <stdbool.h>
 
 #define GKL_MAX_FRAME_SIZE 32 // Максимальный размер кадра (с запасом)
+// Байты, возвращённые на повторный разбор при ресинхронизации (битый кадр + то, что за ним)
+#define GKL_PENDING_SIZE   (2 * GKL_MAX_FRAME_SIZE)
 
 // Структура для хранения разобранного кадра
 typedef struct {
@@ -30,21 +32,54 @@ typedef enum {
     PARSE_IN_PROGRESS,
     PARSE_SUCCESS,
     PARSE_ERROR_CHECKSUM,
-    PARSE_ERROR_TIMEOUT, // (пока не используется, но задел на будущее)
+    PARSE_ERROR_TIMEOUT, // разрыв в линии (RTOF) посреди кадра
     PARSE_ERROR_BUFFER_OVERFLOW
 } GKL_ParseStatus;
 
-// Контекст (состояние) парсера
+// Счётчики экземпляра парсера (для статистики линии)
+typedef struct {
+    uint32_t frames;            // кадров разобрано
+    uint32_t checksum_errors;   // кадров с неверным XOR
+    uint32_t overflows;         // переполнений буфера кадра
+    uint32_t gaps;              // недобранных кадров, сброшенных по разрыву в линии
+} GKL_ParserStats;
+
+struct gkl_dialect_s; // gkl_dialect.h
+
+// Контекст (состояние) парсера — по одному на линию
 typedef struct {
     GKL_ParserFSMState state;
     uint8_t            buffer[GKL_MAX_FRAME_SIZE];
     size_t             idx;
     size_t             expected_len;
     GKL_Frame          parsed_frame;
+    bool               resync;      // после битого кадра перечитать его байты со следующего SYN
+    uint8_t            pending[GKL_PENDING_SIZE]; // ещё не разобранные байты ресинхронизации
+    size_t             npending;    // > 0 — за отданным кадром есть ещё байты, кадр может быть и в них
+    GKL_ParserStats    stats;
+    const struct gkl_dialect_s* dialect; // длины ответов по коду команды
 } GKL_ParserState;
 
 
+// Полная инициализация; ресинхронизация по умолчанию включена, диалект Censtar, счётчики обнулены
 void GKL_Parser_Init(GKL_ParserState* p);
+// Таблица длин ответов другой прошивки ТРК (NULL — Censtar); недобранный кадр сбрасывается
+void GKL_Parser_SetDialect(GKL_ParserState* p, const struct gkl_dialect_s* dialect);
+// Бросить недобранный кадр (новый запрос, ошибка приёма); настройки и счётчики не трогает
+void GKL_Parser_Reset(GKL_ParserState* p);
+// false — прежнее поведение: битый кадр выбрасывается целиком вместе с буфером
+void GKL_Parser_SetResync(GKL_ParserState* p, bool enable);
+// Один байт. За вызов — не больше одного кадра: если ресинхронизация вскрыла
+// несколько, остальные байты ждут в pending и разбираются первыми в следующем вызове
 GKL_ParseStatus GKL_Parser_ConsumeByte(GKL_ParserState* p, uint8_t byte);
+// Вызывается на каждый успешно разобранный кадр из GKL_Parser_ConsumeBuffer
+typedef void (*GKL_FrameCallback)(void* ctx, const GKL_Frame* frame);
+// Разбор пачки байт (DMA-кусок): быстрый поиск SYN, кадр целиком в буфере —
+// проверка и копирование за один шаг; хвост кадра на границе куска — побайтно.
+// Возвращает число разобранных кадров.
+size_t GKL_Parser_ConsumeBuffer(GKL_ParserState* p, const uint8_t* data, size_t len,
+                                GKL_FrameCallback cb, void* ctx);
+// Разрыв в линии от аппаратного таймаута приёма: недобранный кадр (и pending) сбрасывается
+GKL_ParseStatus GKL_Parser_OnGap(GKL_ParserState* p);
 
 #endif /* GKL_PARSER_H_ */
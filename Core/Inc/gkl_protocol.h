@@ -2,28 +2,61 @@
 #define GKL_PROTOCOL_H_
 
 #include "main.h"
+#include <stdbool.h>
 
-/**
- * @brief Инициализирует модуль протокола, связывая его с UART-портами и их буферами.
- * @param huart_trk1 Указатель на UART_HandleTypeDef для нечетных адресов ТРК.
- * @param rx_buf1 Указатель на буфер приема для huart_trk1.
- * @param huart_trk2 Указатель на UART_HandleTypeDef для четных адресов ТРК.
- * @param rx_buf2 Указатель на буфер приема для huart_trk2.
+/*
+ * Кадр уходит в очередь той линии, к которой адрес привязан в таблице
+ * линий (TRK_Bus_Init). Кадры берутся из шаблонов gkl_encode (GKL_Encode_Init).
+ * Все функции возвращают false, если кадр не ушёл в очередь: адрес без линии,
+ * параметр вне диапазона или очередь линии полна. Пистолет — 1..9.
  */
-void GKL_Protocol_Init(UART_HandleTypeDef* huart_trk1, uint8_t* rx_buf1,
-                       UART_HandleTypeDef* huart_trk2, uint8_t* rx_buf2);
 
 /**
  * @brief Отправляет команду запроса статуса.
  * @param slave_addr Адрес ТРК.
  */
-void GKL_SendStatusRequest(uint8_t slave_addr);
+bool GKL_SendStatusRequest(uint8_t slave_addr);
 
 /**
  * @brief Отправляет команду "СТОП".
  * @param slave_addr Адрес ТРК.
  */
-void GKL_SendStop(uint8_t slave_addr);
+bool GKL_SendStop(uint8_t slave_addr);
+
+/** @brief Пуск налива по заданной дозе. */
+bool GKL_SendAuthorize(uint8_t slave_addr);
+
+/** @brief Сброс итога налива: ТРК снова свободна. */
+bool GKL_SendReset(uint8_t slave_addr);
+
+/** @brief Запрос налитого объёма (ответ 'L'). */
+bool GKL_SendVolumeRequest(uint8_t slave_addr);
 
+/** @brief Запрос суммы налива (ответ 'R'). */
+bool GKL_SendMoneyRequest(uint8_t slave_addr);
+
+/** @brief Запрос суммарных счётчиков пистолета (ответ 'T'). */
+bool GKL_SendTotalsRequest(uint8_t slave_addr, uint8_t nozzle);
+
+/** @brief Запрос цены пистолета (ответ 'C'). */
+bool GKL_SendPriceRequest(uint8_t slave_addr, uint8_t nozzle);
+
+/**
+ * @brief Доза в литрах.
+ * @param volume_cl 0..99999, в 0.01 л.
+ */
+bool GKL_SendPresetVolume(uint8_t slave_addr, uint8_t nozzle, uint32_t volume_cl);
+
+/**
+ * @brief Доза на сумму.
+ * @param money_kop 0..99999, коп.
+ */
+bool GKL_SendPresetMoney(uint8_t slave_addr, uint8_t nozzle, uint32_t money_kop);
+
+/**
+ * @brief Установка цены.
+ * @param price_kop 0..999999, коп. за литр.
+ */
+bool GKL_SendSetPrice(uint8_t slave_addr, uint8_t nozzle, uint32_t price_kop);
 
 #endif /* GKL_PROTOCOL_H_ */
@@ -20,4 +20,10 @@ void Log_Byte(const char* direction, uint8_t trk_num, uint8_t byte);
 /* Печать произвольной строки в протокол-лог (USART2). */
 void Log_Proto(const char* fmt, ...);
 
+/* Вывод идёт из очереди по прерываниям: вызывать из HAL_UART_TxCpltCallback. */
+void Log_OnTxComplete(UART_HandleTypeDef* huart);
+
+/* Сколько строк потеряно из-за переполнения очереди вывода (оба канала). */
+uint32_t Log_Dropped(void);
+
 #endif /* LOGGER_H_ */
@@ -0,0 +1,89 @@
+/* File: Core/Inc/spsc_ring.h */
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "main.h"   /* __DMB() из CMSIS */
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Кольцевой буфер байт «один писатель — один читатель» без блокировок.
+ * Писатель — ISR (DMA/UART), читатель — главный цикл.
+ * Ёмкость — степень двойки; head/tail растут свободно, маскируются при доступе,
+ * поэтому used = head - tail корректно и при переполнении uint32_t.
+ */
+typedef struct {
+    uint8_t*          buf;
+    uint32_t          mask;   /* ёмкость - 1 */
+    volatile uint32_t head;   /* пишет только продюсер */
+    volatile uint32_t tail;   /* пишет только консьюмер */
+} spsc_ring_t;
+
+/**
+ * @brief Инициализирует кольцо поверх внешнего хранилища.
+ * @param capacity Размер хранилища, обязательно степень двойки.
+ */
+static inline void spsc_ring_init(spsc_ring_t* r, uint8_t* storage, uint32_t capacity)
+{
+    r->buf  = storage;
+    r->mask = capacity - 1u;
+    r->head = 0u;
+    r->tail = 0u;
+}
+
+static inline uint32_t spsc_ring_used(const spsc_ring_t* r)
+{
+    return r->head - r->tail;
+}
+
+static inline uint32_t spsc_ring_free(const spsc_ring_t* r)
+{
+    return (r->mask + 1u) - (r->head - r->tail);
+}
+
+/**
+ * @brief Записывает до len байт (сторона продюсера).
+ * @return Сколько байт реально записано (остальное не влезло).
+ */
+static inline uint32_t spsc_ring_write(spsc_ring_t* r, const uint8_t* src, uint32_t len)
+{
+    uint32_t head = r->head;
+    uint32_t space = (r->mask + 1u) - (head - r->tail);
+    if (len > space) len = space;
+    if (len == 0u) return 0u;
+
+    uint32_t off   = head & r->mask;
+    uint32_t first = (r->mask + 1u) - off;
+    if (first > len) first = len;
+    memcpy(&r->buf[off], src, first);
+    memcpy(&r->buf[0], src + first, len - first);
+
+    __DMB(); /* данные видимы раньше, чем новый head */
+    r->head = head + len;
+    return len;
+}
+
+/**
+ * @brief Забирает до max байт (сторона консьюмера).
+ * @return Сколько байт прочитано.
+ */
+static inline uint32_t spsc_ring_read(spsc_ring_t* r, uint8_t* dst, uint32_t max)
+{
+    uint32_t tail = r->tail;
+    uint32_t avail = r->head - tail;
+    __DMB(); /* читаем данные только после того, как увидели head */
+    if (max > avail) max = avail;
+    if (max == 0u) return 0u;
+
+    uint32_t off   = tail & r->mask;
+    uint32_t first = (r->mask + 1u) - off;
+    if (first > max) first = max;
+    memcpy(dst, &r->buf[off], first);
+    memcpy(dst + first, &r->buf[0], max - first);
+
+    __DMB(); /* освобождаем место только после копирования */
+    r->tail = tail + max;
+    return max;
+}
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,223 @@
+/* File: Core/Inc/trk_bus.h */
+#ifndef TRK_BUS_H_
+#define TRK_BUS_H_
+
+#include "main.h"
+#include "trk_uart.h"
+#include "gkl_parser.h"
+#include "trk_txn.h"
+#include "trk_live.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Сколько линий (USART) может обслуживать менеджер. H750: USART1..3/6, UART4/5/7/8. */
+#define TRK_BUS_MAX_LINES       8u
+/* Сколько ТРК можно повесить на одну линию RS-485 (адреса GKL 1..32). */
+#define TRK_LINE_MAX_NODES      32u
+/* Пистолетов на ТРК (номера 1..N в ответах); больше — ответы про них не разбираются */
+#ifndef TRK_NODE_MAX_NOZZLES
+#define TRK_NODE_MAX_NOZZLES    4u
+#endif
+
+/* Сырые кадры TX/RX в протокольный лог — только для отладки линии: это строки
+   на каждый обмен, а не на изменения. 1 — включить (или -DTRK_BUS_FRAME_LOG=1) */
+#ifndef TRK_BUS_FRAME_LOG
+#define TRK_BUS_FRAME_LOG       0
+#endif
+
+/* Бит адреса в маске линии: TRK_ADDR(1) | TRK_ADDR(3) ... */
+#define TRK_ADDR(n)             (1UL << ((n) - 1u))
+
+/* Очередь команд линии: на каждый класс приоритета своё кольцо */
+#define TRK_CMD_QUEUE_LEN       4u  /* степень двойки */
+/* Стопы сливаются по адресу — на ТРК не больше одного, так что кольцо на все
+   адреса линии не переполняется даже при «стоп всем» */
+#define TRK_CMD_STOP_QUEUE_LEN  TRK_LINE_MAX_NODES
+
+/* Классы команд, по убыванию приоритета. Опрос по расписанию — ниже всех */
+typedef enum {
+    TRK_PRIO_STOP = 0,     /* 'B' — аварийный стоп */
+    TRK_PRIO_CONTROL,      /* пуск, доза, цена, сброс */
+    TRK_PRIO_QUERY,        /* внеочередные запросы */
+    TRK_PRIO_COUNT         /* = опрос по расписанию */
+} trk_cmd_prio_t;
+
+/* Команда в очереди линии */
+typedef struct {
+    const uint8_t* ext;        /* кадр во флеше (DMA без копии); NULL — кадр в data */
+    uint32_t       t_enq_cyc;  /* постановка в очередь, такты DWT — для задержки стопа */
+    uint8_t        addr;
+    uint8_t        len;
+    uint8_t        data[GKL_CMD_FRAME_MAX];
+} trk_cmd_t;
+
+typedef struct {
+    trk_cmd_t*     q;          /* слоты кольца в trk_line_t */
+    uint8_t        mask;       /* длина кольца - 1 */
+    uint8_t        head;       /* пишет и читает только главный цикл */
+    uint8_t        tail;
+} trk_cmd_queue_t;
+
+/* Описание одной линии — всё, что нужно, чтобы добавить линию в систему */
+typedef struct {
+    const char*          tag;            /* "TRK-1" ... */
+    UART_HandleTypeDef*  huart;          /* UART уже инициализирован CubeMX (MX_xxx_Init) */
+    trk_uart_dma_cfg_t   rx_dma;
+    trk_uart_dma_cfg_t   tx_dma;
+    uint32_t             addr_mask;      /* какие адреса висят на линии: бит (n-1) — ТРК n */
+    uint16_t             start_delay_ms; /* фаза первого опроса, чтобы линии не шли в ногу */
+    trk_uart_de_cfg_t    de;             /* аппаратный DE RS-485; .port = NULL — нет */
+    bool                 saturate;       /* опрос впритык: следующий запрос сразу после ответа
+                                            (только минимальная пауза), без периодов по статусу */
+    const struct gkl_dialect_s* dialect; /* прошивка ТРК на линии (gkl_dialect.h); NULL — Censtar */
+} trk_line_cfg_t;
+
+typedef enum {
+    LINE_IDLE = 0,
+    LINE_TX_PENDING,   /* кадр в очереди/в линии, ждём TC */
+    LINE_WAIT_REPLY,   /* ISR собирает ответ */
+    LINE_REPLY_READY   /* ISR собрал полный кадр, ждёт главный цикл */
+} trk_line_state_t;
+
+/* Флаги пистолета */
+#define TRK_NOZZLE_SEEN         0x01u   /* снимали хоть раз — пистолет есть */
+#define TRK_NOZZLE_PRICE        0x02u   /* цена и сорт прочитаны ('C') */
+#define TRK_NOZZLE_PRICE_ASKED  0x04u   /* 'C' уже спрашивали, ответа не было */
+#define TRK_NOZZLE_TOTALS       0x08u   /* счётчики прочитаны ('T') */
+
+/* Один пистолет ТРК: свой сорт и цена, свои живые значения и своя транзакция */
+typedef struct {
+    uint8_t   flags;           /* TRK_NOZZLE_* */
+    uint8_t   grade;           /* код топлива из 'C' */
+    uint32_t  price_kop;       /* коп. за литр */
+    uint32_t  volume_cl;       /* последний 'L' этого пистолета */
+    uint32_t  money_kop;       /* последний 'R' */
+    uint64_t  totals_cl;       /* суммарные счётчики 'T' */
+    uint64_t  totals_kop;
+    trk_txn_t txn;
+    trk_live_t live;           /* литры/деньги между ответами — для табло */
+} trk_nozzle_t;
+
+/* Одна ТРК на линии: свой кадр опроса, своё расписание и таймауты */
+typedef struct {
+    uint8_t  addr;
+    const uint8_t* poll_frame; /* кадр 'S' из таблицы во флеше (gkl_const_frames.h) */
+    uint8_t  poll_frame_len;
+    uint8_t  miss_streak;      /* таймаутов подряд */
+    uint8_t  status;           /* последний статус из ответа 'S' (gkl_trk_status_t), 0 — ещё не было */
+    uint8_t  nozzle;           /* ASCII из последнего 'S' */
+    uint8_t  active_nozzle;    /* 1..TRK_NODE_MAX_NOZZLES — снятый пистолет, 0 — нет */
+    uint16_t poll_interval_ms; /* текущий период опроса, зависит от статуса */
+    uint32_t t_next_poll_ms;
+    uint32_t polls;
+    uint32_t replies;
+    uint32_t timeouts;
+
+    /* Время ответа: от TC запроса до последнего байта ответа, мкс (сглаживание как в TCP) */
+    uint32_t srtt_us;          /* 0 — замеров ещё не было */
+    uint32_t rttvar_us;
+    uint32_t rtt_last_us;
+    uint32_t rtt_max_us;
+    uint16_t reply_timeout_ms; /* текущий таймаут ответа для этого адреса */
+
+    trk_nozzle_t nozzles[TRK_NODE_MAX_NOZZLES];  /* [номер - 1] */
+} trk_node_t;
+
+/* Счётчики линии */
+typedef struct {
+    uint32_t polls;            /* запросов поставлено в очередь */
+    uint32_t replies;          /* полных кадров принято */
+    uint32_t timeouts;         /* нет ответа за REPLY_TIMEOUT_MS */
+    uint32_t tx_timeouts;      /* не пришёл TC */
+    uint32_t tx_drops;         /* обмен не начался: очередь UART занята, узел ждёт следующего прохода */
+    volatile uint32_t err_flushes;  /* недобранный кадр сброшен по ошибке приёма (ISR) */
+    uint32_t foreign;          /* ответ с чужим адресом */
+    uint32_t unrouted;         /* ответ не отнесён ни к одному пистолету (номер вне 1..TRK_NODE_MAX_NOZZLES) */
+    uint32_t status_changes;   /* смен статуса ТРК (а с ним и периода опроса) */
+    uint32_t util_permille;    /* занятость линии (TX+RX) за последний период, ‰ */
+    uint32_t ready_lat_max_us; /* макс. задержка от кадра в ISR до его обработки в цикле */
+    uint32_t window_bytes;     /* tx_bytes + rx_bytes на начало периода */
+    uint32_t polls_per_sec_x10;  /* измерено за последний период статистики */
+    uint32_t window_polls;     /* polls на начало периода */
+    uint32_t window_start_ms;
+    uint32_t cmds;             /* команд из очереди отправлено */
+    uint32_t cmd_dropped;      /* не встали в очередь: класс переполнен */
+    uint32_t cmd_purged;       /* пуск/доза/запрос снят из очереди стопом на тот же адрес */
+    volatile uint32_t stops;   /* стопов дошло до линии (TC) */
+    volatile uint32_t stop_lat_last_us;  /* от GKL_SendStop до последнего бита 'B' в линии */
+    volatile uint32_t stop_lat_max_us;   /* худший случай с запуска */
+} trk_line_stats_t;
+
+/* Рабочее состояние линии */
+typedef struct {
+    const trk_line_cfg_t*      cfg;
+    uint8_t                    num;            /* 1..N, для логов */
+    volatile trk_line_state_t  state;          /* TX_PENDING -> WAIT_REPLY -> REPLY_READY переводит ISR */
+    volatile uint32_t          t_deadline_ms;  /* таймаут передачи / ожидания ответа */
+    volatile uint32_t          t_tx_done_cyc;  /* TC текущего запроса, такты DWT */
+    volatile uint32_t          t_reply_cyc;    /* событие приёма, завершившее ответ, такты DWT */
+    uint32_t                   t_bus_free_ms;  /* раньше не передаём: пауза после прошлой транзакции */
+    uint32_t                   reply_extra_us; /* ответ на текущий запрос длиннее 'S' на столько по времени */
+    uint8_t                    cur_prio;       /* класс кадра на линии; TRK_PRIO_COUNT — опрос */
+    uint32_t                   cur_enq_cyc;    /* когда он встал в очередь, такты DWT */
+    trk_cmd_queue_t            cmdq[TRK_PRIO_COUNT];
+    trk_cmd_t                  stop_slots[TRK_CMD_STOP_QUEUE_LEN];
+    trk_cmd_t                  cmd_slots[TRK_PRIO_COUNT - 1][TRK_CMD_QUEUE_LEN];
+    trk_node_t                 nodes[TRK_LINE_MAX_NODES];
+    uint8_t                    node_count;
+    uint8_t                    cursor;         /* round-robin: последний опрошенный узел */
+    trk_node_t*                active;         /* узел, чей запрос сейчас на линии */
+    GKL_ParserState            parser;         /* общий движок GKL, свой экземпляр на линию (кормит ISR) */
+    GKL_Frame                  reply;          /* ответ, собранный ISR, для главного цикла */
+    trk_line_stats_t           stats;
+    trk_uart_t                 uart;           /* DMA-приём/передача, кольца, RTO */
+} trk_line_t;
+
+/**
+ * @brief Поднимает все линии из таблицы конфигурации.
+ * @param cfg Таблица линий (должна жить всё время работы — обычно static const).
+ * @param count Количество строк (лишние сверх TRK_BUS_MAX_LINES игнорируются).
+ */
+void TRK_Bus_Init(const trk_line_cfg_t* cfg, size_t count);
+
+/**
+ * @brief Один шаг всех линий: выгрузка RX, автомат опроса, периодическая статистика.
+ */
+void TRK_Bus_Process(void);
+
+/**
+ * @brief Появилась работа после последнего TRK_Bus_Process (ответ готов, команда в очереди).
+ *        Проверять при запрещённых прерываниях перед __WFI: иначе ответ, пришедший
+ *        между проверкой линии и сном, ждёт следующего SysTick.
+ */
+bool TRK_Bus_WorkPending(void);
+
+size_t      TRK_Bus_LineCount(void);
+trk_line_t* TRK_Bus_GetLine(size_t index);
+
+/** @brief Линия, на которой висит ТРК с данным адресом (NULL, если нет). */
+trk_line_t* TRK_Bus_FindLineByAddr(uint8_t slave_addr);
+
+/** @brief Узел ТРК на линии по адресу (NULL, если нет). */
+trk_node_t* TRK_Bus_FindNode(trk_line_t* line, uint8_t slave_addr);
+
+/** @brief Линия по UART-хэндлу (для колбэков HAL; NULL, если не наша). */
+trk_line_t* TRK_Bus_FindLineByHandle(const UART_HandleTypeDef* huart);
+
+/**
+ * @brief Ставит кадр команды в очередь линии, к которой привязан адрес (только из главного цикла).
+ *        Команда уходит в ближайшей паузе на линии — после текущего обмена, раньше опросов;
+ *        старший класс — первым. Повторный стоп на тот же адрес не дублируется,
+ *        а ждущие пуск/доза/запросы этого адреса снимаются — после 'B' насос не перезапустится.
+ * @param in_flash Кадр живёт всё время работы (таблица во флеше) — не копируется.
+ * @return false — адрес без линии, кадр длиннее GKL_CMD_FRAME_MAX или класс переполнен
+ *         (у стопа переполнения не бывает).
+ */
+bool TRK_Bus_QueueCommand(uint8_t slave_addr, trk_cmd_prio_t prio,
+                          const uint8_t* frame, size_t len, bool in_flash);
+
+/** @brief Печатает счётчики всех линий в протокольный лог. */
+void TRK_Bus_LogStats(void);
+
+#endif /* TRK_BUS_H_ */
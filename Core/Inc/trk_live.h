@@ -0,0 +1,48 @@
+/* File: Core/Inc/trk_live.h */
+#ifndef TRK_LIVE_H_
+#define TRK_LIVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Живые литры и деньги для табло между ответами. 'L'/'R' приходят раз в
+ * несколько опросов (во время налива S L S R — по разу за четыре обмена),
+ * и табло, рисующее только их, идёт ступеньками. Оценщик держит последнее
+ * значение от ТРК и сглаженную скорость по соседним замерам и между
+ * ответами продолжает счёт по этой скорости. Новый ответ — значение снова
+ * точное, оценка от него. Нагрузки на линию не добавляет.
+ * Без float: скорость — единиц в мс, Q16. Пишет и читает только главный цикл.
+ */
+
+/* Дальше этого от последнего ответа не продолжаем: ТРК замолчала — стоим */
+#define TRK_LIVE_HORIZON_MS     1000u
+
+/* Один счётчик: литры (0.01 л) или деньги (коп.) */
+typedef struct {
+    uint32_t value;         /* последнее значение от ТРК */
+    uint32_t t_ms;          /* когда пришло */
+    uint32_t rate_q16;      /* единиц в мс, Q16; 0 — стоим */
+    uint8_t  valid;         /* value уже было */
+} trk_live_ctr_t;
+
+typedef struct {
+    trk_live_ctr_t volume;
+    trk_live_ctr_t money;
+    uint8_t        running; /* идёт налив — можно продолжать счёт */
+} trk_live_t;
+
+void TRK_Live_Reset(trk_live_t* lv);
+
+/** @brief Налив пошёл / кончился. Вне налива оценка — ровно последние значения ТРК. */
+void TRK_Live_SetRunning(trk_live_t* lv, bool running);
+
+/** @brief Точные значения из ответов 'L' / 'R'. */
+void TRK_Live_OnVolume(trk_live_t* lv, uint32_t volume_cl, uint32_t now_ms);
+void TRK_Live_OnMoney(trk_live_t* lv, uint32_t money_kop, uint32_t now_ms);
+
+/** @brief Оценка на момент now_ms (для кадра табло). */
+uint32_t TRK_Live_Volume(const trk_live_t* lv, uint32_t now_ms);
+uint32_t TRK_Live_Money(const trk_live_t* lv, uint32_t now_ms);
+
+#endif /* TRK_LIVE_H_ */
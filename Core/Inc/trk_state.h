@@ -0,0 +1,67 @@
+/* File: Core/Inc/trk_state.h */
+#ifndef TRK_STATE_H_
+#define TRK_STATE_H_
+
+#include "trk_bus.h"
+#include "gkl_decode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Последнее известное состояние каждой ТРК: таблица «структура массивов»
+ * [линия][адрес - 1]. Каждый разобранный ответ сравнивается с таблицей,
+ * наружу выходят только настоящие изменения. Изменения одной ТРК копятся
+ * в маске до выборки — пачка ответов между выборками даёт одно событие,
+ * и событие не теряется: в очереди каждая ТРК стоит не более одного раза.
+ * Пишет и читает только главный цикл.
+ */
+
+#define TRK_STATE_ENTRIES   (TRK_BUS_MAX_LINES * TRK_LINE_MAX_NODES)
+
+/* Что изменилось (маска события) */
+#define TRK_CHG_STATUS      0x01u
+#define TRK_CHG_NOZZLE      0x02u
+#define TRK_CHG_VOLUME      0x04u
+#define TRK_CHG_MONEY       0x08u
+#define TRK_CHG_ONLINE      0x10u
+
+typedef struct {
+    uint8_t  status[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];    /* gkl_trk_status_t, 0 — не знаем */
+    uint8_t  nozzle[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];    /* ASCII */
+    uint8_t  online[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];
+    uint32_t volume_cl[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];
+    uint32_t money_kop[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];
+    uint32_t t_change_ms[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];
+} trk_state_table_t;
+
+/* Событие: маска изменений и снимок ТРК на момент выборки */
+typedef struct {
+    uint8_t  line;          /* индекс линии 0..N-1 */
+    uint8_t  addr;
+    uint8_t  changed;       /* TRK_CHG_* */
+    uint8_t  status;
+    uint8_t  nozzle;
+    uint8_t  online;
+    uint32_t volume_cl;
+    uint32_t money_kop;
+    uint32_t t_change_ms;
+} trk_state_event_t;
+
+void TRK_State_Init(void);
+
+/**
+ * @brief Сравнивает разобранный ответ с таблицей и запоминает изменения.
+ * @return TRK_CHG_* — что изменилось (0 — ответ ничего не поменял).
+ */
+uint8_t TRK_State_OnReply(uint8_t line, const GKL_Reply* r, uint32_t now_ms);
+
+/** @brief ТРК пропала с линии / вернулась. */
+uint8_t TRK_State_SetOnline(uint8_t line, uint8_t addr, bool online, uint32_t now_ms);
+
+/** @brief Следующее событие (false — изменений нет). */
+bool TRK_State_PopEvent(trk_state_event_t* ev);
+
+/** @brief Таблица целиком, только для чтения. */
+const trk_state_table_t* TRK_State_Table(void);
+
+#endif /* TRK_STATE_H_ */
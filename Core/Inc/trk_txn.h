@@ -0,0 +1,98 @@
+/* File: Core/Inc/trk_txn.h */
+#ifndef TRK_TXN_H_
+#define TRK_TXN_H_
+
+#include "gkl_decode.h"
+#include "gkl_encode.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Транзакция налива на одной ТРК (не путать с обменом запрос/ответ на линии).
+ * Автомат двигают только разобранные ответы: статус 'S' задаёт фазу, 'L'/'R'
+ * несут живые литры и деньги, 'Z' — подтверждённую дозу, 'T' — счётчики.
+ * Он же подсказывает, что спросить следующим: во время налива к 'S'
+ * подмешиваются 'L'/'R', после окончания — итог и счётчики пистолета.
+ * Закрытая транзакция превращается в компактную запись в кольце записей.
+ * Без malloc и без float; на ТРК — один trk_txn_t, шаг — O(1).
+ */
+
+/* Сколько закрытых транзакций держит кольцо, пока их не забрали (степень двойки) */
+#define TRK_TXN_RECORD_RING     16u
+
+typedef enum {
+    TXN_IDLE = 0,       /* ТРК свободна */
+    TXN_NOZZLE_UP,      /* пистолет снят, дозы нет */
+    TXN_AUTHORIZED,     /* доза задана / пуск разрешён, налива ещё нет */
+    TXN_FUELING,        /* налив: 'L'/'R' — живые значения */
+    TXN_FINISHED,       /* налив окончен, дочитываем итог 'L'/'R' */
+    TXN_TOTALS,         /* итог есть, читаем счётчики 'T' */
+    TXN_CLOSED          /* запись выдана, ждём, пока ТРК вернётся в '0' */
+} trk_txn_state_t;
+
+/* Флаги записи */
+#define TXN_REC_PRESET          0x01u   /* была доза ('Z'), preset — её значение */
+#define TXN_REC_TOTALS          0x02u   /* totals_cl — счётчик после налива */
+#define TXN_REC_ABORTED         0x04u   /* ТРК ушла в '0' раньше, чем дочитали итог */
+
+/* Закрытая транзакция */
+typedef struct {
+    uint8_t  addr;
+    uint8_t  nozzle;        /* ASCII, как в ответе */
+    uint8_t  flags;         /* TXN_REC_* */
+    uint8_t  seq;           /* номер транзакции на этой ТРК (по кругу) */
+    uint32_t volume_cl;     /* налито, 0.01 л */
+    uint32_t money_kop;     /* на сумму, коп. */
+    uint32_t preset;        /* доза, как задавали (0.01 л или коп.), 0 — без дозы */
+    uint32_t t_start_ms;    /* пистолет снят / доза задана */
+    uint32_t duration_ms;   /* до закрытия */
+    uint64_t totals_cl;     /* суммарный счётчик пистолета, если TXN_REC_TOTALS */
+} trk_txn_record_t;
+
+/* События шага (битовая маска) */
+#define TXN_EV_STATE            0x01u   /* сменилась фаза */
+#define TXN_EV_PROGRESS         0x02u   /* новые литры или деньги */
+#define TXN_EV_CLOSED           0x04u   /* транзакция закрыта, запись в кольце */
+
+/* Транзакция одной ТРК */
+typedef struct {
+    uint8_t  addr;
+    uint8_t  state;         /* trk_txn_state_t */
+    uint8_t  nozzle;        /* ASCII, '\0' — ещё не знаем */
+    uint8_t  need;          /* что ещё дочитать после окончания налива */
+    uint8_t  poll_phase;    /* чередование 'S'/'L'/'R' во время налива */
+    uint8_t  flags;         /* TXN_REC_* для будущей записи */
+    uint8_t  seq;
+    uint32_t volume_cl;
+    uint32_t money_kop;
+    uint32_t preset;
+    uint32_t t_start_ms;
+    uint64_t totals_cl;
+} trk_txn_t;
+
+void TRK_Txn_Init(trk_txn_t* t, uint8_t addr);
+
+/**
+ * @brief Следующий запрос к ТРК по фазе транзакции.
+ * @param nozzle Сюда пишется номер пистолета 1..9 для команд с пистолетом ('T').
+ * @return GKL_CMD_STATUS, GKL_CMD_VOLUME, GKL_CMD_MONEY или GKL_CMD_TOTALS.
+ */
+gkl_cmd_id_t TRK_Txn_NextRequest(trk_txn_t* t, uint8_t* nozzle);
+
+/**
+ * @brief Шаг автомата по разобранному ответу этой ТРК.
+ * @param rec Сюда копируется запись при TXN_EV_CLOSED (может быть NULL).
+ * @return TXN_EV_*.
+ */
+uint32_t TRK_Txn_OnReply(trk_txn_t* t, const GKL_Reply* r, uint32_t now_ms, trk_txn_record_t* rec);
+
+/** @brief Забирает самую старую закрытую транзакцию из кольца (false — пусто). */
+bool TRK_Txn_PopRecord(trk_txn_record_t* rec);
+
+/** @brief Сколько записей потеряно из-за полного кольца. */
+uint32_t TRK_Txn_RecordsDropped(void);
+
+const char* TRK_Txn_StateName(trk_txn_state_t s);
+
+#endif /* TRK_TXN_H_ */
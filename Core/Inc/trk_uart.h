@@ -0,0 +1,234 @@
+/* File: Core/Inc/trk_uart.h */
+#ifndef TRK_UART_H_
+#define TRK_UART_H_
+
+#include "main.h"
+#include "spsc_ring.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Кольцевой DMA-буфер: события HT/TC приходят каждые TRK_UART_DMA_RX_SIZE/2 байт,
+   IDLE — в конце каждой посылки. */
+#define TRK_UART_DMA_RX_SIZE   64u
+/* SPSC-кольцо между ISR и главным циклом (степень двойки). */
+#define TRK_UART_RING_SIZE     256u
+/* Очередь готовых кадров на передачу (степень двойки) и макс. размер кадра. */
+#define TRK_UART_TX_QUEUE_LEN  4u
+#define TRK_UART_TX_FRAME_MAX  32u
+/* Очередь отметок «разрыв в линии» (RTOF), степень двойки. RTOF взводится только
+   после принятого символа, поэтому разрывов в куске DMA не больше, чем байт в нём:
+   очередь на полкольца DMA переживает кусок, где каждый байт — отдельная посылка. */
+#define TRK_UART_GAP_QUEUE_LEN (TRK_UART_DMA_RX_SIZE / 2u)
+/* Сколько портов может зарегистрировать транспорт (для диспетчеризации из ISR). */
+#define TRK_UART_MAX_PORTS     8u
+/* 1 — прерывание USART порта разбирает регистровый обработчик транспорта,
+   0 — прежний путь через HAL_UART_IRQHandler. Такты ISR считаются в обоих режимах,
+   чтобы сравнивать на железе. */
+#ifndef TRK_UART_LEAN_ISR
+#define TRK_UART_LEAN_ISR      1
+#endif
+
+/* Метка времени высокого разрешения: такты ядра (DWT->CYCCNT, включается в TRK_UART_Init) */
+static inline uint32_t TRK_UART_Cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+/* Какой DMA-поток обслуживает приём или передачу порта */
+typedef struct {
+    DMA_Stream_TypeDef* stream;   /* DMA1_Stream0 ... */
+    uint32_t            request;  /* DMA_REQUEST_USARTx_RX / _TX */
+    IRQn_Type           irqn;     /* DMA1_Stream0_IRQn ... */
+} trk_uart_dma_cfg_t;
+
+/* Управление драйвером RS-485 выводом DE самого USART (DEM): DE поднимается
+   за DEAT до старт-бита и снимается через DEDT после стоп-бита — без GPIO из ПО.
+   Времена — в 1/16 бита (OVER16), 0..31. */
+typedef struct {
+    GPIO_TypeDef* port;         /* NULL — DE не используется (направлением управляет схема) */
+    uint16_t      pin;          /* USART3_DE: PD12 (PB14 занят RST дисплея); у USART6 DE только PG8 */
+    uint8_t       af;           /* GPIO_AF7_USART3 ... */
+    uint8_t       assert_16;    /* DEAT */
+    uint8_t       deassert_16;  /* DEDT */
+    bool          active_low;   /* DEP: 1 — DE активен низким уровнем */
+} trk_uart_de_cfg_t;
+
+/* Готовый кадр в очереди передачи: своя копия в data или внешний константный кадр */
+typedef struct {
+    uint8_t        len;
+    const uint8_t* ext;         /* не NULL — DMA берёт кадр отсюда (флеш), data не используется */
+    uint8_t        data[TRK_UART_TX_FRAME_MAX];
+} trk_uart_tx_slot_t;
+
+/* Вызывается из ISR, когда последний бит кадра ушёл в линию (флаг TC) */
+typedef void (*trk_uart_tx_done_cb_t)(void* ctx);
+/* Вызываются из ISR: новые байты прямо из DMA-буфера / линия замолчала (RTOF) */
+typedef void (*trk_uart_rx_cb_t)(void* ctx, const uint8_t* data, uint32_t len);
+typedef void (*trk_uart_gap_cb_t)(void* ctx);
+/* Вызывается из ISR: ошибка приёма (маска HAL_UART_ERROR_*), уже выгруженные байты —
+   до неё. Текущий кадр испорчен, следующий надо ловить с нового SYN. */
+typedef void (*trk_uart_err_cb_t)(void* ctx, uint32_t errors);
+
+/* Транспорт одного TRK-порта: кольцевой DMA-приём + SPSC-кольцо, очередь TX по DMA */
+typedef struct {
+    UART_HandleTypeDef* huart;
+    DMA_HandleTypeDef   hdma_rx;
+    DMA_HandleTypeDef   hdma_tx;
+    uint8_t             dma_rx_buf[TRK_UART_DMA_RX_SIZE];
+    uint16_t            dma_rx_pos;     /* до какого места DMA-буфер уже разобран */
+    uint8_t             ring_storage[TRK_UART_RING_SIZE];
+    spsc_ring_t         rx_ring;
+
+    /* Статистика (пишет ISR) */
+    volatile uint32_t   rx_events;      /* IDLE/HT/TC */
+    volatile uint32_t   rx_bytes;
+    volatile uint32_t   rx_dropped;     /* не влезло в кольцо */
+    volatile uint32_t   last_rx_cyc;    /* TRK_UART_Cycles() события, принёсшего последние байты */
+    trk_uart_rx_cb_t    rx_cb;          /* разбор прямо в ISR, до кольца главного цикла */
+    trk_uart_gap_cb_t   gap_cb;
+    trk_uart_err_cb_t   err_cb;
+    void*               rx_ctx;
+
+    /* Ошибки приёма: флаг снимается прямо в ISR, кольцевой DMA продолжает работу */
+    volatile uint32_t   err_ore;
+    volatile uint32_t   err_fe;
+    volatile uint32_t   err_ne;
+    volatile uint32_t   err_pe;
+    volatile uint32_t   err_dma;
+    volatile uint32_t   rx_rearms;      /* приём остановился (HAL/DMA) и был перезапущен */
+
+    /* Цена прерывания USART, такты ядра */
+    volatile uint32_t   isr_calls;
+    volatile uint32_t   isr_cyc_sum;
+    volatile uint32_t   isr_cyc_max;
+
+    /* Аппаратный таймаут приёма (RTOR/RTOF): позиции кольца, где линия замолчала */
+    uint32_t            gap_pos[TRK_UART_GAP_QUEUE_LEN];
+    volatile uint8_t    gap_head;       /* пишет ISR */
+    volatile uint8_t    gap_tail;       /* пишет главный цикл */
+    volatile uint32_t   rx_gaps;
+    volatile uint32_t   gaps_dropped;   /* отметка не встала: очередь полна, кадры склеятся */
+    volatile uint32_t   last_gap_ms;
+
+    /* TX: пишет главный цикл (head), забирает ISR (tail) */
+    trk_uart_tx_slot_t    tx_q[TRK_UART_TX_QUEUE_LEN];
+    volatile uint8_t      tx_head;
+    volatile uint8_t      tx_tail;
+    volatile uint8_t      tx_busy;      /* DMA-передача в процессе */
+    trk_uart_tx_done_cb_t tx_done_cb;
+    void*                 tx_done_ctx;
+    volatile uint32_t     tx_frames;
+    volatile uint32_t     tx_bytes;     /* ушло в линию (по TC) */
+    volatile uint32_t     tx_done_cyc;  /* TRK_UART_Cycles() последнего TC */
+    volatile uint32_t     tx_dropped;   /* очередь полна или DMA не стартовал */
+} trk_uart_t;
+
+/**
+ * @brief Настраивает DMA-поток и запускает кольцевой приём с детектом IDLE.
+ * @param u Транспорт порта.
+ * @param huart Уже инициализированный UART (MX_USARTx_UART_Init).
+ * @param rx_dma Поток DMA для приёма.
+ * @param tx_dma Поток DMA для передачи.
+ * @param de Аппаратный DE для RS-485 или NULL (DEM/DEAT/DEDT пишутся только при UE=0,
+ *           поэтому — здесь, до запуска DMA).
+ * @return HAL_OK при успехе.
+ */
+HAL_StatusTypeDef TRK_UART_Init(trk_uart_t* u, UART_HandleTypeDef* huart,
+                                const trk_uart_dma_cfg_t* rx_dma,
+                                const trk_uart_dma_cfg_t* tx_dma,
+                                const trk_uart_de_cfg_t* de);
+
+/**
+ * @brief Регистрирует колбэк окончания передачи кадра (вызывается из ISR).
+ */
+void TRK_UART_SetTxDoneCallback(trk_uart_t* u, trk_uart_tx_done_cb_t cb, void* ctx);
+
+/**
+ * @brief Регистрирует обработчики приёма в контексте ISR (байты видны им раньше,
+ *        чем главному циклу через кольцо). Кольцо при этом наполняется как обычно.
+ */
+void TRK_UART_SetRxCallbacks(trk_uart_t* u, trk_uart_rx_cb_t on_bytes,
+                             trk_uart_gap_cb_t on_gap, trk_uart_err_cb_t on_error, void* ctx);
+
+/**
+ * @brief Ставит готовый кадр в очередь передачи и, если линия свободна, запускает DMA.
+ *        Не блокирует: кадр копируется в очередь.
+ * @return true, если кадр принят в очередь.
+ */
+bool TRK_UART_Send(trk_uart_t* u, const uint8_t* frame, size_t len);
+
+/**
+ * @brief Как TRK_UART_Send, но без копирования: DMA читает кадр прямо из frame.
+ *        Кадр должен жить всё время работы и быть доступен DMA1/2 — таблицы
+ *        const во флеше (gkl_const_frames.h) или в AXI SRAM, не DTCM.
+ */
+bool TRK_UART_SendConst(trk_uart_t* u, const uint8_t* frame, size_t len);
+
+/**
+ * @brief Обработчик окончания передачи (вызывать из HAL_UART_TxCpltCallback).
+ */
+void TRK_UART_OnTxComplete(trk_uart_t* u);
+
+/**
+ * @brief Обработчик события приёма (вызывать из HAL_UARTEx_RxEventCallback).
+ * @param pos Текущая позиция записи DMA в буфере (аргумент Size колбэка).
+ */
+void TRK_UART_OnRxEvent(trk_uart_t* u, uint16_t pos);
+
+/**
+ * @brief Ошибка приёма по версии HAL (вызывать из HAL_UART_ErrorCallback).
+ *        Считает классы ошибок и, если HAL остановил DMA-приём, сразу перезапускает его.
+ */
+void TRK_UART_OnError(trk_uart_t* u);
+
+/**
+ * @brief Страховка из главного цикла: приём по какой-то причине стоит — перезапустить.
+ */
+void TRK_UART_CheckRx(trk_uart_t* u);
+
+/**
+ * @brief Забирает накопленные байты пачкой (главный цикл).
+ * @return Количество прочитанных байт.
+ */
+size_t TRK_UART_Read(trk_uart_t* u, uint8_t* dst, size_t max);
+
+/**
+ * @brief Включает аппаратный таймаут приёма: после gap_bits битовых интервалов
+ *        тишины после последнего символа ISR ставит отметку «разрыв» в поток.
+ * @param gap_bits Длительность тишины в битах (1..0xFFFFFF).
+ */
+HAL_StatusTypeDef TRK_UART_EnableGapDetect(trk_uart_t* u, uint32_t gap_bits);
+
+/**
+ * @brief Как TRK_UART_Read, но останавливается на ближайшей отметке разрыва.
+ * @param gap Выставляется в true, если прочитанное закончилось разрывом в линии
+ *            (отметка снимается с очереди).
+ */
+size_t TRK_UART_ReadUntilGap(trk_uart_t* u, uint8_t* dst, size_t max, bool* gap);
+
+/**
+ * @brief Прерывание USART порта (вызывать первым в USARTx_IRQHandler).
+ *        TRK_UART_LEAN_ISR=1: читает ISR/ICR напрямую — ошибки, RTOF, IDLE, TC —
+ *        и не заходит в HAL. TRK_UART_LEAN_ISR=0: PreHandler + HAL_UART_IRQHandler.
+ * @return true, если прерывание обработано; false — порт не наш, пусть разбирает HAL.
+ */
+bool TRK_UART_IRQHandler(UART_HandleTypeDef* huart);
+
+/**
+ * @brief Ранняя обработка прерывания USART (вызывать в USARTx_IRQHandler
+ *        до HAL_UART_IRQHandler). Снимает RTOF, чтобы HAL не счёл его ошибкой
+ *        и не остановил DMA-приём.
+ */
+void TRK_UART_IRQPreHandler(UART_HandleTypeDef* huart);
+
+/**
+ * @brief Обработчик прерывания DMA-потока: находит порт, которому принадлежит поток,
+ *        и передаёт управление HAL. Вызывать из DMAx_StreamY_IRQHandler.
+ */
+void TRK_UART_DMA_IRQHandler(DMA_Stream_TypeDef* stream);
+
+/** @brief Зарегистрированный транспорт по UART-хэндлу (NULL, если не наш). */
+trk_uart_t* TRK_UART_FromHandle(UART_HandleTypeDef* huart);
+
+#endif /* TRK_UART_H_ */
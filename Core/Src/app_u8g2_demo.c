@@ -1,7 +1,50 @@
 // Core/Src/app_u8g2_demo.c
 #include "app_u8g2_demo.h"
+#include "trk_bus.h"
+#include "trk_live.h"
+#include <stdio.h>
+
+// Кадр табло: 10 в секунду. 'L' во время налива приходит раз в ~200 мс, так что
+// между ответами — одна промежуточная оценка (trk_live.h); опросов на линии не прибавляется.
+#define APP_FRAME_MS    100u
+
+// Экран 256x64 поделён на полосы по строкам тайлов (8 px): шапка, литры, деньги.
+// Перерисовывается только полоса, где сменился текст, и только на ширину текста.
+// Отправка — по одной строке тайлов за вызов: SPI блокирующий, а из того же цикла
+// крутятся линии ТРК. Строка на всю ширину — 32 тайла по 32 байта, ~1 мс на 12 МГц,
+// меньше паузы между обменами (TURNAROUND_MS); весь экран целиком (~5.5 мс) — никогда.
+enum { BAND_HEAD, BAND_VOLUME, BAND_MONEY, BAND_COUNT };
+
+static const struct {
+    uint8_t row;        // первая строка тайлов (логически, как рисуем)
+    uint8_t rows;
+    uint8_t baseline;   // y базовой линии текста
+} s_bands[BAND_COUNT] = {
+    [BAND_HEAD]   = { 0, 2, 10 },  // 6x10
+    [BAND_VOLUME] = { 2, 3, 36 },  // logisoso16: цифры 20..35
+    [BAND_MONEY]  = { 5, 3, 62 },  //             46..61
+};
+
+#define APP_TILES_W     32u     // 256 / 8
+#define APP_TILES_H     8u      // 64 / 8
 
 static u8g2_t u8g2;
+static uint32_t s_t_next_frame_ms;
+
+// Что сейчас на экране: перерисовываем, только если поменялось
+static struct {
+    const trk_nozzle_t *nz;
+    uint8_t  addr;
+    uint8_t  nozzle;
+    uint32_t volume_cl;
+    uint32_t money_kop;
+} s_shown;
+
+static uint16_t s_band_w[BAND_COUNT];  // ширина текста в буфере, px
+static uint16_t s_send_w[BAND_COUNT];  // сколько отправить: и новый текст, и стереть старый
+static uint8_t  s_dirty;               // полосы, нарисованные в буфере, но не отправленные
+static uint8_t  s_send_band;
+static uint8_t  s_send_row;
 
 void APP_U8G2_Init(void) {
     U8G2_HAL_Init(); // безопасные уровни + DWT
@@ -9,7 +52,123 @@ void APP_U8G2_Init(void) {
     u8g2_Demo(&u8g2);
 }
 
+// Полоса заново в буфере; на экран уйдёт по строкам из App_SendStep
+static void App_DrawBand(uint8_t b, const uint8_t *font, const char *text) {
+    u8g2_SetDrawColor(&u8g2, 0);
+    u8g2_DrawBox(&u8g2, 0, (u8g2_uint_t)(s_bands[b].row * 8u), 256, (u8g2_uint_t)(s_bands[b].rows * 8u));
+    u8g2_SetDrawColor(&u8g2, 1);
+    u8g2_SetFont(&u8g2, font);
+    uint16_t w = (uint16_t)u8g2_DrawStr(&u8g2, 0, s_bands[b].baseline, text);
+
+    uint16_t prev = (s_dirty & (1u << b)) ? s_send_w[b] : s_band_w[b];
+    s_send_w[b] = (w > prev) ? w : prev;
+    s_band_w[b] = w;
+    s_dirty |= (uint8_t)(1u << b);
+    if (s_send_band == b) s_send_row = 0;   // полоса сменилась посреди отправки — с начала
+}
+
+// Одна строка тайлов одной полосы на экран. Буфер u8g2 — в координатах контроллера,
+// а рисуем с U8G2_R2 (u8g2_Init): логический тайл (x, y) лежит в (31 - x, 7 - y)
+static void App_SendStep(void) {
+    while (s_dirty) {
+        uint8_t b = s_send_band;
+        if (!(s_dirty & (1u << b))) {
+            s_send_band = (uint8_t)((b + 1u) % BAND_COUNT);
+            s_send_row  = 0;
+            continue;
+        }
+        uint8_t tw = (uint8_t)((s_send_w[b] + 7u) / 8u);
+        if (tw > APP_TILES_W) tw = APP_TILES_W;
+        if (tw) {
+            uint8_t ty = (uint8_t)(APP_TILES_H - 1u - (s_bands[b].row + s_send_row));
+            u8g2_UpdateDisplayArea(&u8g2, (uint8_t)(APP_TILES_W - tw), ty, tw, 1);
+        }
+        if (++s_send_row >= s_bands[b].rows || !tw) {
+            s_dirty    &= (uint8_t)~(1u << b);
+            s_send_row  = 0;
+            s_send_band = (uint8_t)((b + 1u) % BAND_COUNT);
+        }
+        return;
+    }
+}
+
+// Продажа на экране — от начала налива до закрытия транзакции (итог и счётчики)
+static bool App_InSale(const trk_nozzle_t *nz) {
+    return nz->txn.state == TXN_FUELING || nz->txn.state == TXN_FINISHED || nz->txn.state == TXN_TOTALS;
+}
+
+// Первый пистолет с продажей по всем линиям (NULL — продаж нет)
+static const trk_nozzle_t* App_FindSale(uint8_t *addr, uint8_t *nozzle) {
+    for (size_t l = 0; l < TRK_Bus_LineCount(); l++) {
+        const trk_line_t *line = TRK_Bus_GetLine(l);
+        for (uint8_t i = 0; i < line->node_count; i++) {
+            const trk_node_t *node = &line->nodes[i];
+            if (!node->active_nozzle) continue;
+            const trk_nozzle_t *nz = &node->nozzles[node->active_nozzle - 1u];
+            if (!App_InSale(nz)) continue;
+            *addr   = node->addr;
+            *nozzle = node->active_nozzle;
+            return nz;
+        }
+    }
+    return NULL;
+}
+
 void APP_U8G2_Loop(void) {
-    // Можешь добавить анимацию/перерисовку тут.
-    HAL_Delay(1000);
+    // Не блокировать: из того же цикла крутятся линии ТРК.
+    // Недоотправленные полосы — раньше нового кадра, по строке за проход
+    if (s_dirty) {
+        App_SendStep();
+        return;
+    }
+
+    uint32_t now = HAL_GetTick();
+    if ((int32_t)(now - s_t_next_frame_ms) < 0) return;
+    s_t_next_frame_ms = now + APP_FRAME_MS;
+
+    uint8_t addr = 0, nozzle = 0;
+    const trk_nozzle_t *nz = App_FindSale(&addr, &nozzle);
+    if (!nz) {
+        // Продаж нет — остаётся последняя показанная, но с итогом от ТРК, а не с оценкой
+        if (!s_shown.nz) return;
+        nz     = s_shown.nz;
+        addr   = s_shown.addr;
+        nozzle = s_shown.nozzle;
+    }
+
+    // Во время налива — оценка между ответами; после — ровно то, что ответила ТРК
+    uint32_t vol, money;
+    if (nz->txn.state == TXN_FUELING) {
+        vol   = TRK_Live_Volume(&nz->live, now);
+        money = TRK_Live_Money(&nz->live, now);
+    } else {
+        vol   = nz->txn.volume_cl;
+        money = nz->txn.money_kop;
+    }
+
+    char line[24];
+    if (!s_shown.nz) {
+        // Первая продажа: демо-картинку стираем целиком, но тоже по строкам
+        u8g2_ClearBuffer(&u8g2);
+        for (uint8_t b = 0; b < BAND_COUNT; b++) s_band_w[b] = 256;
+    }
+    if (!s_shown.nz || s_shown.addr != addr || s_shown.nozzle != nozzle) {
+        snprintf(line, sizeof(line), "TRK %u  nozzle %u", (unsigned)addr, (unsigned)nozzle);
+        App_DrawBand(BAND_HEAD, u8g2_font_6x10_tf, line);
+    }
+    if (!s_shown.nz || s_shown.volume_cl != vol) {
+        snprintf(line, sizeof(line), "%lu.%02lu L", (unsigned long)(vol / 100u), (unsigned long)(vol % 100u));
+        App_DrawBand(BAND_VOLUME, u8g2_font_logisoso16_tr, line);
+    }
+    if (!s_shown.nz || s_shown.money_kop != money) {
+        snprintf(line, sizeof(line), "%lu.%02lu", (unsigned long)(money / 100u), (unsigned long)(money % 100u));
+        App_DrawBand(BAND_MONEY, u8g2_font_logisoso16_tr, line);
+    }
+    s_shown.nz = nz;
+    s_shown.addr = addr;
+    s_shown.nozzle = nozzle;
+    s_shown.volume_cl = vol;
+    s_shown.money_kop = money;
+
+    App_SendStep();
 }
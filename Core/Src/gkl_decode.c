@@ -0,0 +1,127 @@
+#include "gkl_decode.h"
+#include "gkl_dialect.h"
+
+#define GKL_FIELD_SEP ';'
+
+// Длины полей данных, под которые написаны разборщики (раскладка Censtar)
+#define LEN_STATUS   2u    // status + nozzle
+#define LEN_VOLUME  10u    // nozzle + id + status + ';' + volume(6)
+#define LEN_MONEY   10u    // nozzle + id + status + ';' + money(6)
+#define LEN_TOTALS  22u    // nozzle ; volume(10) ; money(9)
+#define LEN_PRICE   11u    // nozzle ; price(6) ; grade(2)
+#define LEN_PRESET   6u    // nozzle + dose(5)
+
+bool gkl_ascii_to_u32(const uint8_t* s, size_t len, uint32_t* out)
+{
+    uint64_t v;
+    if (len > 9 || !gkl_ascii_to_u64(s, len, &v)) return false; // 9 цифр гарантированно влезают
+    *out = (uint32_t)v;
+    return true;
+}
+
+bool gkl_ascii_to_u64(const uint8_t* s, size_t len, uint64_t* out)
+{
+    if (!s || !out || len == 0 || len > 19) return false;
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t d = (uint8_t)(s[i] - '0');
+        if (d > 9u) return false;
+        v = v * 10u + d;
+    }
+    *out = v;
+    return true;
+}
+
+// Смещения полей фиксированы, поэтому каждый разборщик принимает только свою длину:
+// диалект с другой длиной поля не получит молча чужие байты
+bool gkl_decode_status(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_STATUS) return false;
+    out->u.status.status = d[0];
+    out->u.status.nozzle = d[1];
+    return true;
+}
+
+bool gkl_decode_volume(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_VOLUME) return false;
+    GKL_VolumeReply* r = &out->u.volume;
+    if (d[3] != GKL_FIELD_SEP) return false;
+    r->nozzle = d[0];
+    r->id     = d[1];
+    r->status = d[2];
+    return gkl_ascii_to_u32(&d[4], 6, &r->volume_cl);
+}
+
+bool gkl_decode_money(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_MONEY) return false;
+    GKL_MoneyReply* r = &out->u.money;
+    if (d[3] != GKL_FIELD_SEP) return false;
+    r->nozzle = d[0];
+    r->id     = d[1];
+    r->status = d[2];
+    return gkl_ascii_to_u32(&d[4], 6, &r->money_kop);
+}
+
+bool gkl_decode_totals(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_TOTALS) return false;
+    GKL_TotalsReply* r = &out->u.totals;
+    if (d[1] != GKL_FIELD_SEP || d[12] != GKL_FIELD_SEP) return false;
+    r->nozzle = d[0];
+    return gkl_ascii_to_u64(&d[2], 10, &r->volume_cl) &&
+           gkl_ascii_to_u64(&d[13], 9, &r->money_kop);
+}
+
+bool gkl_decode_price(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_PRICE) return false;
+    GKL_PriceReply* r = &out->u.price;
+    uint32_t grade;
+    if (d[1] != GKL_FIELD_SEP || d[8] != GKL_FIELD_SEP) return false;
+    r->nozzle = d[0];
+    if (!gkl_ascii_to_u32(&d[2], 6, &r->price_kop) || !gkl_ascii_to_u32(&d[9], 2, &grade)) return false;
+    r->grade = (uint8_t)grade;
+    return true;
+}
+
+bool gkl_decode_preset(const uint8_t* d, size_t len, GKL_Reply* out)
+{
+    if (len != LEN_PRESET) return false;
+    GKL_PresetReply* r = &out->u.preset;
+    r->nozzle = d[0];
+    return gkl_ascii_to_u32(&d[1], 5, &r->dose);
+}
+
+const gkl_dialect_t GKL_DIALECT_CENSTAR = {
+    .name  = "censtar",
+    .reply = {
+        ['S' - 'A'] = { LEN_STATUS, gkl_decode_status },
+        ['D' - 'A'] = { LEN_STATUS, gkl_decode_status },
+        ['L' - 'A'] = { LEN_VOLUME, gkl_decode_volume },
+        ['R' - 'A'] = { LEN_MONEY,  gkl_decode_money  },
+        ['T' - 'A'] = { LEN_TOTALS, gkl_decode_totals },
+        ['C' - 'A'] = { LEN_PRICE,  gkl_decode_price  },
+        ['Z' - 'A'] = { LEN_PRESET, gkl_decode_preset },
+    },
+};
+
+bool GKL_DecodeWith(const gkl_dialect_t* dialect, uint8_t slave_addr, uint8_t cmd,
+                    const uint8_t* data, size_t len, GKL_Reply* out)
+{
+    if (!dialect || !data || !out) return false;
+
+    const gkl_reply_desc_t* desc = GKL_Dialect_Reply(dialect, cmd);
+    if (!desc || desc->data_len != len || !desc->decode) return false;
+
+    out->slave_addr = slave_addr;
+    out->cmd        = cmd;
+    return desc->decode(data, len, out);
+}
+
+bool GKL_Decode(uint8_t slave_addr, uint8_t cmd, const uint8_t* data, size_t len, GKL_Reply* out)
+{
+    return GKL_DecodeWith(&GKL_DIALECT_CENSTAR, slave_addr, cmd, data, len, out);
+}
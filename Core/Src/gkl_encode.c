@@ -0,0 +1,133 @@
+#include "gkl_encode.h"
+#include "gkl_frame.h"
+#include "gkl_const_frames.h"
+#include <string.h>
+
+#define GKL_ADDR_MIN     1u
+#define GKL_ADDR_MAX     32u
+#define GKL_DATA_POS     4u    // SYN + ADDR_HI + ADDR_LO + CMD
+
+// Код команды и поле данных шаблона (нули на месте чисел, пистолет 1)
+typedef struct {
+    uint8_t     cmd;
+    const char* data;
+} gkl_cmd_desc_t;
+
+static const gkl_cmd_desc_t s_cmds[GKL_CMD_COUNT] = {
+    [GKL_CMD_STATUS]        = { 'S', ""         },
+    [GKL_CMD_STOP]          = { 'B', ""         },
+    [GKL_CMD_AUTHORIZE]     = { 'G', ""         },
+    [GKL_CMD_RESET]         = { 'N', ""         },
+    [GKL_CMD_VOLUME]        = { 'L', ""         },
+    [GKL_CMD_MONEY]         = { 'R', ""         },
+    [GKL_CMD_TOTALS]        = { 'T', "1"        },
+    [GKL_CMD_PRICE]         = { 'C', "1"        },
+    [GKL_CMD_PRESET_VOLUME] = { 'V', "100000"   },
+    [GKL_CMD_PRESET_MONEY]  = { 'M', "100000"   },
+    [GKL_CMD_SET_PRICE]     = { 'P', "1;000000" },
+};
+
+// Команды без данных идут в enum первыми — их кадры собраны компилятором во флеш
+#define GKL_CMD_CONST_COUNT  ((size_t)GKL_CMD_TOTALS)
+
+static const uint8_t s_const_tpl[GKL_CMD_CONST_COUNT][GKL_ADDR_MAX][GKL_CONST_FRAME_LEN] = {
+    [GKL_CMD_STATUS]    = GKL_CONST_FRAMES_ALL('S'),
+    [GKL_CMD_STOP]      = GKL_CONST_FRAMES_ALL('B'),
+    [GKL_CMD_AUTHORIZE] = GKL_CONST_FRAMES_ALL('G'),
+    [GKL_CMD_RESET]     = GKL_CONST_FRAMES_ALL('N'),
+    [GKL_CMD_VOLUME]    = GKL_CONST_FRAMES_ALL('L'),
+    [GKL_CMD_MONEY]     = GKL_CONST_FRAMES_ALL('R'),
+};
+
+// Шаблоны команд с данными: [адрес-1][команда - GKL_CMD_CONST_COUNT]; длина от адреса не зависит
+static uint8_t s_tpl[GKL_ADDR_MAX][GKL_CMD_COUNT - GKL_CMD_CONST_COUNT][GKL_CMD_FRAME_MAX];
+static uint8_t s_tpl_len[GKL_CMD_COUNT - GKL_CMD_CONST_COUNT];
+
+void GKL_Encode_Init(void) {
+    for (size_t c = GKL_CMD_CONST_COUNT; c < GKL_CMD_COUNT; ++c) {
+        const gkl_cmd_desc_t* d = &s_cmds[c];
+        size_t len = 0;
+        for (uint8_t a = GKL_ADDR_MIN; a <= GKL_ADDR_MAX; ++a) {
+            len = gkl_build_frame(a, d->cmd, (const uint8_t*)d->data, strlen(d->data),
+                                  s_tpl[a - 1u][c - GKL_CMD_CONST_COUNT], GKL_CMD_FRAME_MAX);
+        }
+        s_tpl_len[c - GKL_CMD_CONST_COUNT] = (uint8_t)len;
+    }
+}
+
+uint8_t GKL_Encode_CmdCode(gkl_cmd_id_t id) {
+    return ((unsigned)id < GKL_CMD_COUNT) ? s_cmds[id].cmd : 0u;
+}
+
+const uint8_t* GKL_Encode_Template(uint8_t slave_addr, gkl_cmd_id_t id, size_t* len) {
+    if (slave_addr < GKL_ADDR_MIN || slave_addr > GKL_ADDR_MAX || (unsigned)id >= GKL_CMD_COUNT) {
+        return NULL;
+    }
+    if ((size_t)id < GKL_CMD_CONST_COUNT) {
+        if (len) *len = GKL_CONST_FRAME_LEN;
+        return s_const_tpl[id][slave_addr - 1u];
+    }
+    size_t k = (size_t)id - GKL_CMD_CONST_COUNT;
+    if (s_tpl_len[k] == 0) return NULL; // GKL_Encode_Init ещё не вызывали
+    if (len) *len = s_tpl_len[k];
+    return s_tpl[slave_addr - 1u][k];
+}
+
+// Копия шаблона в out; 0 — нет шаблона или не влезает
+static size_t copy_template(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t* out, size_t cap) {
+    size_t len = 0;
+    const uint8_t* tpl = GKL_Encode_Template(slave_addr, id, &len);
+    if (!tpl || !out || cap < len) return 0u;
+    memcpy(out, tpl, len);
+    return len;
+}
+
+// Замена байта поля с поправкой XOR (последний байт кадра): xor ^= старый ^ новый
+static void patch_byte(uint8_t* frame, size_t len, size_t pos, uint8_t value) {
+    frame[len - 1u] ^= (uint8_t)(frame[pos] ^ value);
+    frame[pos] = value;
+}
+
+// Число в width ASCII-цифр с ведущими нулями (в шаблоне на их месте '0')
+static bool patch_digits(uint8_t* frame, size_t len, size_t pos, size_t width, uint32_t value) {
+    for (size_t i = width; i-- > 0; ) {
+        patch_byte(frame, len, pos + i, (uint8_t)('0' + value % 10u));
+        value /= 10u;
+    }
+    return value == 0u; // остаток — число длиннее width цифр
+}
+
+static bool nozzle_ok(uint8_t nozzle) {
+    return nozzle >= 1u && nozzle <= 9u;
+}
+
+size_t GKL_Encode(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t* out, size_t cap) {
+    if ((size_t)id >= GKL_CMD_CONST_COUNT) return 0u;
+    return copy_template(slave_addr, id, out, cap);
+}
+
+size_t GKL_Encode_Nozzle(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t nozzle,
+                         uint8_t* out, size_t cap) {
+    if ((id != GKL_CMD_TOTALS && id != GKL_CMD_PRICE) || !nozzle_ok(nozzle)) return 0u;
+    size_t len = copy_template(slave_addr, id, out, cap);
+    if (len) patch_byte(out, len, GKL_DATA_POS, (uint8_t)('0' + nozzle));
+    return len;
+}
+
+size_t GKL_Encode_Preset(uint8_t slave_addr, gkl_cmd_id_t id, uint8_t nozzle, uint32_t dose,
+                         uint8_t* out, size_t cap) {
+    if ((id != GKL_CMD_PRESET_VOLUME && id != GKL_CMD_PRESET_MONEY) || !nozzle_ok(nozzle)) return 0u;
+    size_t len = copy_template(slave_addr, id, out, cap);
+    if (!len) return 0u;
+    patch_byte(out, len, GKL_DATA_POS, (uint8_t)('0' + nozzle));
+    return patch_digits(out, len, GKL_DATA_POS + 1u, 5u, dose) ? len : 0u;
+}
+
+size_t GKL_Encode_SetPrice(uint8_t slave_addr, uint8_t nozzle, uint32_t price_kop,
+                           uint8_t* out, size_t cap) {
+    if (!nozzle_ok(nozzle)) return 0u;
+    size_t len = copy_template(slave_addr, GKL_CMD_SET_PRICE, out, cap);
+    if (!len) return 0u;
+    patch_byte(out, len, GKL_DATA_POS, (uint8_t)('0' + nozzle));
+    return patch_digits(out, len, GKL_DATA_POS + 2u, 6u, price_kop) ? len : 0u; // после ';'
+}
@@ -1,13 +1,24 @@
 #include "gkl_frame.h"
 #include <stddef.h> // Для NULL
+#include <string.h>
 
 #define GKL_SYN          0x02u // Стартовый байт
 #define GKL_ADDR_HI      0x00u // Старший байт адреса всегда 0x00
 #define GKL_MAX_DATA     22u   // Максимальная длина поля данных
 
 uint8_t gkl_checksum_xor(const uint8_t* bytes, size_t len) {
-    uint8_t xor_sum = 0u;
-    for (size_t i = 0; i < len; ++i) {
+    // XOR не зависит от порядка — считаем словами по 4 байта и сворачиваем в конце
+    uint32_t acc = 0u;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, &bytes[i], sizeof(w)); // невыровненное чтение, на M7 — один LDR
+        acc ^= w;
+    }
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
+    uint8_t xor_sum = (uint8_t)acc;
+    for (; i < len; ++i) {
         xor_sum ^= bytes[i];
     }
     return xor_sum;
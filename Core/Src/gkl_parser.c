@@ -1,29 +1,55 @@
 #include "gkl_parser.h"
 #include "gkl_frame.h" // Нужен для gkl_checksum_xor
+#include "gkl_dialect.h"
+#include <string.h>
 
-// Таблица ожидаемой длины ПОЛЕЙ ДАННЫХ для каждого типа ответа
-// Длина = Response data length из протокола
-static size_t get_expected_data_len(uint8_t cmd) {
-    switch (cmd) {
-        case 'S': return 2;  // status + nozzle
-        case 'L': return 10; // nozzle + id + status + ';' + volume(6)
-        case 'R': return 10; // nozzle + id + status + ';' + money(6)
-        case 'T': return 22; // ...
-        case 'C': return 11; // ...
-        case 'Z': return 6;  // ...
-        case 'D': return 2;  // ...
-        default:  return 0;
-    }
+// Длина поля данных ответа берётся из таблицы диалекта прямым индексом по коду
+// команды; 0 — неизвестная команда (или длиннее GKL_Frame.data), не заголовок кадра
+static inline size_t get_expected_data_len(const GKL_ParserState* p, uint8_t cmd) {
+    size_t len = GKL_Dialect_DataLen(p->dialect, cmd);
+    return (len <= sizeof(p->parsed_frame.data)) ? len : 0u;
 }
 
-void GKL_Parser_Init(GKL_ParserState* p) {
+// Сброс разбора без изменения настроек парсера
+static void parser_restart(GKL_ParserState* p) {
     p->state = PARSER_STATE_WAIT_SYN;
     p->idx = 0;
 }
 
-GKL_ParseStatus GKL_Parser_ConsumeByte(GKL_ParserState* p, uint8_t byte) {
+// Сброс вместе с байтами, ждущими повторного разбора
+static void parser_flush(GKL_ParserState* p) {
+    parser_restart(p);
+    p->npending = 0;
+}
+
+void GKL_Parser_Init(GKL_ParserState* p) {
+    parser_flush(p);
+    p->resync  = true;
+    p->dialect = &GKL_DIALECT_CENSTAR;
+    memset(&p->stats, 0, sizeof(p->stats));
+}
+
+void GKL_Parser_SetDialect(GKL_ParserState* p, const struct gkl_dialect_s* dialect) {
+    p->dialect = dialect ? dialect : &GKL_DIALECT_CENSTAR;
+    parser_flush(p); // недобранный кадр разбирался по старой таблице
+}
+
+void GKL_Parser_Reset(GKL_ParserState* p) {
+    parser_flush(p);
+}
+
+void GKL_Parser_SetResync(GKL_ParserState* p, bool enable) {
+    p->resync = enable;
+}
+
+// Внутренний итог шага: заголовок не похож на кадр — это был не SYN
+#define STEP_REJECT ((GKL_ParseStatus)-1)
+
+// Один байт через автомат. Заголовок проверяется сразу (ADDR_HI = 0, адрес 1..32,
+// известная команда), чтобы байт 0x02 внутри данных не держал парсер до конца «кадра».
+static GKL_ParseStatus parser_step(GKL_ParserState* p, uint8_t byte) {
     if (p->idx >= GKL_MAX_FRAME_SIZE) {
-        GKL_Parser_Init(p);
+        p->stats.overflows++;
         return PARSE_ERROR_BUFFER_OVERFLOW;
     }
 
@@ -36,21 +62,24 @@ GKL_ParseStatus GKL_Parser_ConsumeByte(GKL_ParserState* p, uint8_t byte) {
             break;
 
         case PARSER_STATE_WAIT_ADDR_HI:
+            if (byte != 0x00) return STEP_REJECT;
             p->buffer[p->idx++] = byte;
             p->state = PARSER_STATE_WAIT_ADDR_LO;
             break;
 
         case PARSER_STATE_WAIT_ADDR_LO:
+            if (byte < 1 || byte > 32) return STEP_REJECT;
             p->buffer[p->idx++] = byte;
             p->parsed_frame.slave_addr = byte;
             p->state = PARSER_STATE_WAIT_CMD;
             break;
 
         case PARSER_STATE_WAIT_CMD:
+            p->expected_len = get_expected_data_len(p, byte);
+            if (p->expected_len == 0) return STEP_REJECT;
             p->buffer[p->idx++] = byte;
             p->parsed_frame.cmd = byte;
-            p->expected_len = get_expected_data_len(byte);
-            p->state = (p->expected_len > 0) ? PARSER_STATE_WAIT_DATA : PARSER_STATE_WAIT_CHECKSUM;
+            p->state = PARSER_STATE_WAIT_DATA;
             break;
 
         case PARSER_STATE_WAIT_DATA:
@@ -66,19 +95,151 @@ GKL_ParseStatus GKL_Parser_ConsumeByte(GKL_ParserState* p, uint8_t byte) {
             size_t checksum_len = p->idx - 1; // Все байты в буфере, кроме SYN
             uint8_t calculated_checksum = gkl_checksum_xor(&p->buffer[1], checksum_len);
 
-            if (received_checksum == calculated_checksum) {
-                // Успех! Копируем данные в выходную структуру
-                p->parsed_frame.data_len = p->expected_len;
-                for (size_t i = 0; i < p->expected_len; ++i) {
-                    p->parsed_frame.data[i] = p->buffer[4 + i];
-                }
-                GKL_Parser_Init(p); // Сброс для следующего кадра
-                return PARSE_SUCCESS;
-            } else {
-                GKL_Parser_Init(p); // Сброс
+            if (received_checksum != calculated_checksum) {
+                p->stats.checksum_errors++;
                 return PARSE_ERROR_CHECKSUM;
             }
+            // Успех! Копируем данные в выходную структуру
+            p->parsed_frame.data_len = p->expected_len;
+            for (size_t i = 0; i < p->expected_len; ++i) {
+                p->parsed_frame.data[i] = p->buffer[4 + i];
+            }
+            parser_restart(p); // Сброс для следующего кадра
+            p->stats.frames++;
+            return PARSE_SUCCESS;
         }
     }
     return PARSE_IN_PROGRESS;
 }
+
+// Разбор p->pending до первого кадра. Байты за ним остаются в pending — их
+// разбирает следующий вызов. Каждый возврат выбрасывает как минимум ложный SYN,
+// поэтому объём не растёт.
+static GKL_ParseStatus parser_run(GKL_ParserState* p) {
+    GKL_ParseStatus result = PARSE_IN_PROGRESS;
+    size_t ip = 0;
+
+    while (ip < p->npending) {
+        uint8_t b = p->pending[ip++];
+        GKL_ParseStatus st = parser_step(p, b);
+
+        if (st == PARSE_SUCCESS) {
+            result = PARSE_SUCCESS; // хвост — следующему вызову
+            break;
+        }
+        if (st == PARSE_IN_PROGRESS) continue;
+
+        if (st != STEP_REJECT) {
+            result = st; // ошибка контрольной суммы / переполнение
+        }
+
+        if (!p->resync) {
+            parser_restart(p);
+            continue;
+        }
+
+        // Кадр не сложился: всё после его SYN, включая сорвавший байт, — на повторный разбор.
+        // Настоящий кадр, начавшийся внутри битого, так не теряется.
+        uint8_t replay[GKL_PENDING_SIZE];
+        size_t  nr = 0;
+        for (size_t i = 1; i < p->idx; ++i) replay[nr++] = p->buffer[i];
+        replay[nr++] = b;
+        while (ip < p->npending && nr < sizeof(replay)) replay[nr++] = p->pending[ip++];
+
+        parser_restart(p);
+        memcpy(p->pending, replay, nr);
+        p->npending = nr;
+        ip = 0;
+    }
+    p->npending -= ip;
+    if (p->npending) memmove(p->pending, &p->pending[ip], p->npending);
+    return result;
+}
+
+GKL_ParseStatus GKL_Parser_ConsumeByte(GKL_ParserState* p, uint8_t byte) {
+    // Новый байт — за байтами, оставшимися с прошлого вызова
+    if (p->npending >= sizeof(p->pending)) {
+        p->stats.overflows++;
+        parser_flush(p);
+    }
+    p->pending[p->npending++] = byte;
+    return parser_run(p);
+}
+
+// Заголовок кадра правдоподобен: SYN, ADDR_HI = 0, адрес 1..32, известная команда
+static size_t frame_len_if_header_ok(const GKL_ParserState* p, const uint8_t* b) {
+    if (b[0] != 0x02 || b[1] != 0x00 || b[2] < 1 || b[2] > 32) return 0;
+    size_t dlen = get_expected_data_len(p, b[3]);
+    return dlen ? (5 + dlen) : 0; // SYN + ADDR(2) + CMD + DATA + XOR
+}
+
+// Побайтный путь от позиции *pos, пока автомат не вернётся к поиску SYN
+static size_t consume_bytewise(GKL_ParserState* p, const uint8_t* data, size_t len, size_t* pos,
+                               GKL_FrameCallback cb, void* ctx) {
+    size_t frames = 0;
+    do {
+        GKL_ParseStatus st = GKL_Parser_ConsumeByte(p, data[(*pos)++]);
+        // Ресинхронизация могла вскрыть за кадром ещё кадры — отдаём все, pending до дна
+        while (st == PARSE_SUCCESS) {
+            frames++;
+            if (cb) cb(ctx, &p->parsed_frame);
+            st = p->npending ? parser_run(p) : PARSE_IN_PROGRESS;
+        }
+    } while (*pos < len && p->idx > 0);
+    return frames;
+}
+
+size_t GKL_Parser_ConsumeBuffer(GKL_ParserState* p, const uint8_t* data, size_t len,
+                                GKL_FrameCallback cb, void* ctx) {
+    size_t frames = 0;
+    size_t i = 0;
+    if (!p || !data) return 0;
+
+    while (i < len) {
+        // Посреди кадра (начало пришло прошлым куском) или остались байты
+        // после GKL_Parser_ConsumeByte — доедаем побайтно
+        if (p->idx > 0 || p->npending > 0) {
+            frames += consume_bytewise(p, data, len, &i, cb, ctx);
+            continue;
+        }
+
+        // Быстрый поиск начала кадра
+        const uint8_t* syn = memchr(&data[i], 0x02, len - i);
+        if (!syn) break;
+        i = (size_t)(syn - data);
+
+        // Кадр (или даже заголовок) не влез в кусок — начало отдаём побайтному автомату
+        size_t flen = (len - i >= 4) ? frame_len_if_header_ok(p, syn) : 0;
+        if (len - i < 4 || (flen && len - i < flen)) {
+            frames += consume_bytewise(p, data, len, &i, cb, ctx);
+            continue;
+        }
+        if (flen == 0) { i++; continue; } // ложный SYN
+
+        // Кадр целиком в буфере: XOR от ADDR_HI до последнего байта данных
+        if (gkl_checksum_xor(&syn[1], flen - 2) != syn[flen - 1]) {
+            // Битый кадр: с ресинхронизацией ищем следующий SYN внутри него, без — пропускаем целиком
+            p->stats.checksum_errors++;
+            i += p->resync ? 1 : flen;
+            continue;
+        }
+        p->parsed_frame.slave_addr = syn[2];
+        p->parsed_frame.cmd        = syn[3];
+        p->parsed_frame.data_len   = flen - 5;
+        memcpy(p->parsed_frame.data, &syn[4], flen - 5);
+        i += flen;
+        frames++;
+        p->stats.frames++;
+        if (cb) cb(ctx, &p->parsed_frame);
+    }
+    return frames;
+}
+
+GKL_ParseStatus GKL_Parser_OnGap(GKL_ParserState* p) {
+    if (p->state == PARSER_STATE_WAIT_SYN && p->npending == 0) {
+        return PARSE_IN_PROGRESS; // кадр не начат — сбрасывать нечего
+    }
+    parser_flush(p);
+    p->stats.gaps++;
+    return PARSE_ERROR_TIMEOUT;
+}
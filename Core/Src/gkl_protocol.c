@@ -1,56 +1,94 @@
 #include "gkl_protocol.h"
-#include "gkl_frame.h"
-#include "usart.h"
-#include "logger.h"  // Log_Frame (USART2)
+#include "gkl_encode.h"
+#include "trk_bus.h"
 
-static UART_HandleTypeDef* trk1_huart = NULL;
-static UART_HandleTypeDef* trk2_huart = NULL;
-
-/* Мы больше НЕ храним внешние RX-буферы — приёмом управляет только main.c */
-
-void GKL_Protocol_Init(UART_HandleTypeDef* huart_trk1, uint8_t* rx_buf1_unused,
-                       UART_HandleTypeDef* huart_trk2, uint8_t* rx_buf2_unused)
-{
-    (void)rx_buf1_unused;
-    (void)rx_buf2_unused;
-    trk1_huart = huart_trk1;
-    trk2_huart = huart_trk2;
-}
+/* Приёмом и передачей управляет менеджер линий; здесь — только постановка команд в его очередь */
 
 /**
  * @brief Внутренняя отправка кадра на нужный порт.
  * ВАЖНО: не трогаем приём (не Abort/Receive_IT здесь), чтобы не терять SYN.
+ * Кадр встаёт в очередь команд своей линии и уходит в ближайшей паузе между
+ * обменами, а не поверх чужого ответа; вызов не блокирует.
+ * in_flash — кадр из таблицы во флеше, не копируется.
  */
-static void send_frame_to_trk(uint8_t slave_addr, uint8_t* frame, size_t frame_len)
+static bool send_frame_to_trk(uint8_t slave_addr, const uint8_t* frame, size_t frame_len,
+                              bool in_flash, trk_cmd_prio_t prio)
+{
+    if (frame == NULL || frame_len == 0) return false;
+
+    /* Линию выбирает таблица конфигурации, а не чётность адреса */
+    return TRK_Bus_QueueCommand(slave_addr, prio, frame, frame_len, in_flash);
+}
+
+/* Команда без данных: кадр из таблицы во флеше уходит по DMA без копирования */
+static bool send_template(uint8_t slave_addr, gkl_cmd_id_t id, trk_cmd_prio_t prio)
 {
-    if (frame == NULL || frame_len == 0) return;
+    size_t len = 0;
+    const uint8_t* frame = GKL_Encode_Template(slave_addr, id, &len);
+    return send_frame_to_trk(slave_addr, frame, frame ? len : 0u, true, prio);
+}
 
-    UART_HandleTypeDef* huart = (slave_addr % 2U != 0U) ? trk1_huart : trk2_huart;
-    uint8_t trk_num = (slave_addr % 2U != 0U) ? 1U : 2U;
+bool GKL_SendStatusRequest(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_STATUS, TRK_PRIO_QUERY);
+}
 
-    if (huart == NULL) return;
+bool GKL_SendStop(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_STOP, TRK_PRIO_STOP);
+}
 
-    /* Протокольный лог: сырой TX-кадр (время печатает logger) */
-    Log_Frame("TX", trk_num, frame, frame_len);
+bool GKL_SendAuthorize(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_AUTHORIZE, TRK_PRIO_CONTROL);
+}
 
-    /* Отправка (блокирующая) */
-    (void)HAL_UART_Transmit(huart, frame, (uint16_t)frame_len, 100);
+bool GKL_SendReset(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_RESET, TRK_PRIO_CONTROL);
+}
+
+bool GKL_SendVolumeRequest(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_VOLUME, TRK_PRIO_QUERY);
+}
+
+bool GKL_SendMoneyRequest(uint8_t slave_addr)
+{
+    return send_template(slave_addr, GKL_CMD_MONEY, TRK_PRIO_QUERY);
+}
+
+bool GKL_SendTotalsRequest(uint8_t slave_addr, uint8_t nozzle)
+{
+    uint8_t frame[GKL_CMD_FRAME_MAX];
+    size_t len = GKL_Encode_Nozzle(slave_addr, GKL_CMD_TOTALS, nozzle, frame, sizeof(frame));
+    return send_frame_to_trk(slave_addr, frame, len, false, TRK_PRIO_QUERY);
+}
+
+bool GKL_SendPriceRequest(uint8_t slave_addr, uint8_t nozzle)
+{
+    uint8_t frame[GKL_CMD_FRAME_MAX];
+    size_t len = GKL_Encode_Nozzle(slave_addr, GKL_CMD_PRICE, nozzle, frame, sizeof(frame));
+    return send_frame_to_trk(slave_addr, frame, len, false, TRK_PRIO_QUERY);
+}
+
+bool GKL_SendPresetVolume(uint8_t slave_addr, uint8_t nozzle, uint32_t volume_cl)
+{
+    uint8_t frame[GKL_CMD_FRAME_MAX];
+    size_t len = GKL_Encode_Preset(slave_addr, GKL_CMD_PRESET_VOLUME, nozzle, volume_cl, frame, sizeof(frame));
+    return send_frame_to_trk(slave_addr, frame, len, false, TRK_PRIO_CONTROL);
 }
 
-void GKL_SendStatusRequest(uint8_t slave_addr)
+bool GKL_SendPresetMoney(uint8_t slave_addr, uint8_t nozzle, uint32_t money_kop)
 {
-    uint8_t frame_buffer[16];
-    size_t frame_len = gkl_build_frame(slave_addr, 'S', NULL, 0, frame_buffer, sizeof(frame_buffer));
-    if (frame_len > 0U) {
-        send_frame_to_trk(slave_addr, frame_buffer, frame_len);
-    }
+    uint8_t frame[GKL_CMD_FRAME_MAX];
+    size_t len = GKL_Encode_Preset(slave_addr, GKL_CMD_PRESET_MONEY, nozzle, money_kop, frame, sizeof(frame));
+    return send_frame_to_trk(slave_addr, frame, len, false, TRK_PRIO_CONTROL);
 }
 
-void GKL_SendStop(uint8_t slave_addr)
+bool GKL_SendSetPrice(uint8_t slave_addr, uint8_t nozzle, uint32_t price_kop)
 {
-    uint8_t frame_buffer[16];
-    size_t frame_len = gkl_build_frame(slave_addr, 'B', NULL, 0, frame_buffer, sizeof(frame_buffer));
-    if (frame_len > 0U) {
-        send_frame_to_trk(slave_addr, frame_buffer, frame_len);
-    }
+    uint8_t frame[GKL_CMD_FRAME_MAX];
+    size_t len = GKL_Encode_SetPrice(slave_addr, nozzle, price_kop, frame, sizeof(frame));
+    return send_frame_to_trk(slave_addr, frame, len, false, TRK_PRIO_CONTROL);
 }
@@ -8,6 +8,73 @@
 #define SYS_LOG_UART    (&huart1)   /* USART1 — системный лог */
 #define PROTO_LOG_UART  (&huart2)   /* USART2 — лог протокола */
 #define LOG_BUFFER_SIZE 256
+#define LOG_TX_RING_SIZE 4096       /* очередь вывода на канал: ~0.35 с при 115200 */
+
+/*
+ * Вывод не блокирует: строка копируется в кольцо канала, а кольцо уходит
+ * HAL_UART_Transmit_IT кусками. USART в режиме FIFO (usart.c), поэтому
+ * прерывание приходит на порог TX FIFO и докладывает сразу несколько байт.
+ * Писать можно и из главного цикла, и из ISR — вставка под PRIMASK.
+ */
+typedef struct {
+    UART_HandleTypeDef* huart;
+    uint8_t             buf[LOG_TX_RING_SIZE];
+    uint32_t            head;       /* свободно растущие, как в spsc_ring */
+    uint32_t            tail;
+    uint16_t            inflight;   /* столько байт от tail сейчас передаёт HAL */
+    uint32_t            dropped;    /* строк, не влезших в кольцо */
+} log_chan_t;
+
+static log_chan_t s_sys   = { .huart = SYS_LOG_UART };
+static log_chan_t s_proto = { .huart = PROTO_LOG_UART };
+
+/* Запуск следующего куска. Вызывать при запрещённых прерываниях. */
+static void chan_kick(log_chan_t* c)
+{
+    if (c->inflight || c->head == c->tail) return;
+
+    uint32_t off = c->tail & (LOG_TX_RING_SIZE - 1u);
+    uint32_t len = c->head - c->tail;
+    if (len > LOG_TX_RING_SIZE - off) len = LOG_TX_RING_SIZE - off;   /* до конца буфера */
+    if (len > 0xFFFFu) len = 0xFFFFu;
+
+    if (HAL_UART_Transmit_IT(c->huart, &c->buf[off], (uint16_t)len) == HAL_OK) {
+        c->inflight = (uint16_t)len;
+    }
+}
+
+static void chan_write(log_chan_t* c, const char* data, size_t len)
+{
+    if (len == 0) return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (len > LOG_TX_RING_SIZE - (c->head - c->tail)) {
+        /* Строку целиком или никак — обрывки в логе хуже пропуска */
+        c->dropped++;
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            c->buf[(c->head + i) & (LOG_TX_RING_SIZE - 1u)] = (uint8_t)data[i];
+        }
+        c->head += (uint32_t)len;
+        chan_kick(c);
+    }
+    __set_PRIMASK(primask);
+}
+
+void Log_OnTxComplete(UART_HandleTypeDef* huart)
+{
+    log_chan_t* c = (huart == s_sys.huart) ? &s_sys : (huart == s_proto.huart) ? &s_proto : NULL;
+    if (!c) return;
+    c->tail += c->inflight;
+    c->inflight = 0;
+    chan_kick(c);
+}
+
+uint32_t Log_Dropped(void)
+{
+    return s_sys.dropped + s_proto.dropped;
+}
 
 void Log_System(const char* fmt, ...)
 {
@@ -18,7 +85,7 @@ void Log_System(const char* fmt, ...)
     va_end(args);
     if (len <= 0) return;
     if (len > (int)sizeof(buffer)) len = (int)sizeof(buffer);
-    HAL_UART_Transmit(SYS_LOG_UART, (uint8_t*)buffer, (uint16_t)len, 100);
+    chan_write(&s_sys, buffer, (size_t)len);
 }
 
 void Log_Frame(const char* direction, uint8_t trk_num, const uint8_t* frame, size_t length)
@@ -52,7 +119,7 @@ void Log_Frame(const char* direction, uint8_t trk_num, const uint8_t* frame, siz
         line[sizeof(line)-1] = '\n';
     }
 
-    HAL_UART_Transmit(PROTO_LOG_UART, (uint8_t*)line, (uint16_t)off, 100);
+    chan_write(&s_proto, line, off);
 }
 
 void Log_Byte(const char* direction, uint8_t trk_num, uint8_t byte)
@@ -64,7 +131,7 @@ void Log_Byte(const char* direction, uint8_t trk_num, uint8_t byte)
                      (unsigned long)t, (unsigned)trk_num, direction, byte);
     if (n <= 0) return;
     if (n > (int)sizeof(line)) n = (int)sizeof(line);
-    HAL_UART_Transmit(PROTO_LOG_UART, (uint8_t*)line, (uint16_t)n, 100);
+    chan_write(&s_proto, line, (size_t)n);
 }
 
 void Log_Proto(const char* fmt, ...)
@@ -76,5 +143,5 @@ void Log_Proto(const char* fmt, ...)
     va_end(args);
     if (len <= 0) return;
     if (len > (int)sizeof(buffer)) len = (int)sizeof(buffer);
-    HAL_UART_Transmit(PROTO_LOG_UART, (uint8_t*)buffer, (uint16_t)len, 100);
+    chan_write(&s_proto, buffer, (size_t)len);
 }
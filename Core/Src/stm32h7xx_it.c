@@ -22,6 +22,7 @@
 #include "stm32h7xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "trk_uart.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -322,6 +323,7 @@ void USART2_IRQHandler(void)
 void USART3_IRQHandler(void)
 {
   /* USER CODE BEGIN USART3_IRQn 0 */
+  if (TRK_UART_IRQHandler(&huart3)) return;   /* линия ТРК: обработчик транспорта */
 
   /* USER CODE END USART3_IRQn 0 */
   HAL_UART_IRQHandler(&huart3);
@@ -336,6 +338,7 @@ void USART3_IRQHandler(void)
 void USART6_IRQHandler(void)
 {
   /* USER CODE BEGIN USART6_IRQn 0 */
+  if (TRK_UART_IRQHandler(&huart6)) return;   /* линия ТРК: обработчик транспорта */
 
   /* USER CODE END USART6_IRQn 0 */
   HAL_UART_IRQHandler(&huart6);
@@ -346,4 +349,21 @@ void USART6_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/* Потоки DMA обслуживают TRK-линии; владельца потока находит транспорт по таблице */
+void DMA1_Stream0_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream0); }
+void DMA1_Stream1_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream1); }
+void DMA1_Stream2_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream2); }
+void DMA1_Stream3_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream3); }
+void DMA1_Stream4_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream4); }
+void DMA1_Stream5_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream5); }
+void DMA1_Stream6_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream6); }
+void DMA1_Stream7_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA1_Stream7); }
+void DMA2_Stream0_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream0); }
+void DMA2_Stream1_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream1); }
+void DMA2_Stream2_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream2); }
+void DMA2_Stream3_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream3); }
+void DMA2_Stream4_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream4); }
+void DMA2_Stream5_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream5); }
+void DMA2_Stream6_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream6); }
+void DMA2_Stream7_IRQHandler(void) { TRK_UART_DMA_IRQHandler(DMA2_Stream7); }
 /* USER CODE END 1 */
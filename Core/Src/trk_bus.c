@@ -0,0 +1,966 @@
+/* File: Core/Src/trk_bus.c */
+#include "trk_bus.h"
+#include "gkl_frame.h"
+#include "gkl_decode.h"
+#include "gkl_dialect.h"
+#include "gkl_encode.h"
+#include "trk_state.h"
+#include "logger.h"
+#include <string.h>
+
+/* Тайминги */
+#define POLL_INTERVAL_MS        200u   // период опроса ТРК с неизвестным статусом
+#define POLL_ACTIVE_MS           50u   // пистолет снят / доза задана / налив — нужны свежие литры и деньги
+#define POLL_IDLE_MS            500u   // ТРК свободна
+#define POLL_BACKOFF_MAX_MS    5000u   // не отвечает: период удваивается с каждым таймаутом до этого
+#define REPLY_TIMEOUT_MS         80u   // строго по ts — потолок адаптивного таймаута
+#define REPLY_TIMEOUT_MIN_MS     10u   // пол: ответ 7 байт при 9600 сам по себе ≈ 7.3 мс
+#define TX_TIMEOUT_MS            50u   // страховка: TC так и не пришёл
+#define INTERBYTE_GAP_BITS       29u   // tif ≈ 3 мс при 9600 бод; считает USART (RTOR)
+#define TURNAROUND_MS             4u   // мин. пауза от конца ответа до следующего запроса (> tif)
+#define UART_CHAR_BITS           10u   // 8N1: старт + 8 + стоп — для подсчёта занятости линии
+#define STATS_PERIOD_MS       10000u   // период печати счётчиков линий
+#define NODE_OFFLINE_MISSES       3u   // столько таймаутов подряд — ТРК считаем отключённой
+#define GKL_STATUS_REPLY_LEN      7u   // ответ 'S' целиком — по нему меряется время ответа
+
+/* Индексы колец — по маске */
+_Static_assert((TRK_CMD_QUEUE_LEN & (TRK_CMD_QUEUE_LEN - 1u)) == 0 &&
+               (TRK_CMD_STOP_QUEUE_LEN & (TRK_CMD_STOP_QUEUE_LEN - 1u)) == 0 &&
+               TRK_CMD_STOP_QUEUE_LEN <= 128u, "command rings must be powers of two");
+
+static trk_line_t s_lines[TRK_BUS_MAX_LINES];
+/* Есть работа для главного цикла, появившаяся после того, как он прошёл линии:
+   ставят ISR (ответ готов) и очередь команд, снимает TRK_Bus_Process */
+static volatile uint32_t s_work_pending;
+static size_t     s_line_count;
+static uint32_t   s_t_next_stats_ms;
+
+/* =========================
+ *  Узлы и планировщик опроса
+ * ========================= */
+static void Node_Init(trk_node_t *node, uint8_t addr, uint32_t t_first_poll_ms)
+{
+    memset(node, 0, sizeof(*node));
+    node->addr           = addr;
+    node->t_next_poll_ms = t_first_poll_ms;
+    node->poll_interval_ms = POLL_INTERVAL_MS;
+    node->reply_timeout_ms = REPLY_TIMEOUT_MS;   /* пока не измерили — по протоколу */
+    /* Кадр опроса 'S' неизменен для адреса — собран компилятором, лежит во флеше */
+    size_t len = 0;
+    node->poll_frame     = GKL_Encode_Template(addr, GKL_CMD_STATUS, &len);
+    node->poll_frame_len = node->poll_frame ? (uint8_t)len : 0u;
+    for (uint8_t n = 0; n < TRK_NODE_MAX_NOZZLES; n++) {
+        TRK_Txn_Init(&node->nozzles[n].txn, addr);
+    }
+}
+
+/* Номер пистолета из ответа (ASCII) -> 1..TRK_NODE_MAX_NOZZLES, 0 — нет такого */
+static uint8_t Node_NozzleIndex(uint8_t nozzle)
+{
+    uint8_t n = (uint8_t)(nozzle - '0');
+    return (n >= 1u && n <= TRK_NODE_MAX_NOZZLES) ? n : 0u;
+}
+
+/* Период опроса по состоянию ТРК: активные чаще, свободные и молчащие реже.
+   Пропускная способность линии та же — её забирают те, у кого сейчас налив. */
+static uint16_t Node_PollInterval(const trk_node_t *node)
+{
+    /* Молчит — экспоненциальный откат: 200, 400, 800 ... POLL_BACKOFF_MAX_MS */
+    if (node->miss_streak > 0) {
+        uint8_t  shift = (node->miss_streak > 6u) ? 5u : (uint8_t)(node->miss_streak - 1u);
+        uint32_t ms    = (uint32_t)POLL_INTERVAL_MS << shift;
+        return (uint16_t)((ms > POLL_BACKOFF_MAX_MS) ? POLL_BACKOFF_MAX_MS : ms);
+    }
+
+    switch (node->status)
+    {
+        case GKL_TRK_NOZZLE_UP:
+        case GKL_TRK_AUTHORIZED:
+        case GKL_TRK_FUELING:
+        case GKL_TRK_FINISHED:
+            return POLL_ACTIVE_MS;
+        case GKL_TRK_OFF:
+            return POLL_IDLE_MS;
+        default:
+            return POLL_INTERVAL_MS;
+    }
+}
+
+/* Новый замер времени ответа: SRTT/RTTVAR по RFC 6298, таймаут = SRTT + 4*RTTVAR.
+   Здоровая ТРК отвечает за единицы мс — и пропавшая стоит линии столько же, а не 80 мс. */
+static void Node_OnRttSample(trk_node_t *node, uint32_t rtt_us)
+{
+    node->rtt_last_us = rtt_us;
+    if (rtt_us > node->rtt_max_us) node->rtt_max_us = rtt_us;
+
+    if (node->srtt_us == 0) {
+        node->srtt_us   = rtt_us;
+        node->rttvar_us = rtt_us / 2u;
+    } else {
+        uint32_t err = (rtt_us > node->srtt_us) ? rtt_us - node->srtt_us : node->srtt_us - rtt_us;
+        node->rttvar_us = (3u * node->rttvar_us + err) / 4u;
+        node->srtt_us   = (7u * node->srtt_us + rtt_us) / 8u;
+    }
+
+    /* +1 мс на дискретность HAL_GetTick, которым меряется дедлайн */
+    uint32_t rto_ms = (node->srtt_us + 4u * node->rttvar_us + 999u) / 1000u + 1u;
+    if (rto_ms < REPLY_TIMEOUT_MIN_MS) rto_ms = REPLY_TIMEOUT_MIN_MS;
+    if (rto_ms > REPLY_TIMEOUT_MS)     rto_ms = REPLY_TIMEOUT_MS;
+    node->reply_timeout_ms = (uint16_t)rto_ms;
+}
+
+/* Таймаут: как в TCP, удваиваем (до потолка) — медленную ТРК не потеряем навсегда */
+static void Node_OnReplyTimeout(trk_node_t *node)
+{
+    uint32_t rto_ms = (uint32_t)node->reply_timeout_ms * 2u;
+    node->reply_timeout_ms = (uint16_t)((rto_ms > REPLY_TIMEOUT_MS) ? REPLY_TIMEOUT_MS : rto_ms);
+}
+
+/* Следующий узел по кругу, которому пора на опрос; NULL — все ещё отдыхают.
+   Начинаем сразу за последним опрошенным, чтобы ни один узел не голодал. */
+static trk_node_t* Line_PickNextNode(trk_line_t *line, uint32_t now)
+{
+    for (uint8_t k = 1; k <= line->node_count; k++)
+    {
+        uint8_t i = (uint8_t)((line->cursor + k) % line->node_count);
+        trk_node_t *node = &line->nodes[i];
+        if ((int32_t)(now - node->t_next_poll_ms) >= 0) {
+            line->cursor = i;
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/* Транзакция с узлом закончена (ответ или таймаут) — линия свободна для следующего */
+static void Line_FinishTransaction(trk_line_t *line, uint32_t now)
+{
+    trk_node_t *node = line->active;
+    if (node) {
+        node->poll_interval_ms = Node_PollInterval(node);
+        /* В режиме насыщения отвечающий узел снова в очереди сразу — темп задаёт только линия;
+           молчащий и здесь уходит в откат */
+        node->t_next_poll_ms   = (line->cfg->saturate && node->miss_streak == 0)
+                               ? now : now + node->poll_interval_ms;
+        line->active = NULL;
+    }
+    line->t_bus_free_ms = now + TURNAROUND_MS;
+    line->state = LINE_IDLE;
+}
+
+/* =========================
+ *  Передача запроса
+ * ========================= */
+/* Длина кадра ответа на команду (код — 4-й байт кадра запроса): 02 00 ADDR CMD DATA XOR.
+   Длина поля данных — из диалекта линии */
+static uint32_t Reply_FrameLen(const trk_line_t *line, uint8_t cmd)
+{
+    uint8_t reply;
+    switch (cmd)
+    {
+        case 'L':
+        case 'R':
+        case 'T':
+        case 'C': reply = cmd; break;
+        case 'P': reply = 'C'; break;
+        case 'V':
+        case 'M': reply = 'Z'; break;    /* подтверждение дозы */
+        default:  reply = 'S'; break;
+    }
+    size_t dlen = GKL_Dialect_DataLen(line->parser.dialect, reply);
+    return dlen ? 5u + (uint32_t)dlen : GKL_STATUS_REPLY_LEN;
+}
+
+/* Один обмен на линии: кадр -> TC -> ответ. Состояние выставляется до постановки
+   в очередь UART — TC может прийти сразу. false — очередь UART занята: линия снова
+   свободна, а расписание узла не трогаем — кадра в линии не было, повтор на следующем проходе */
+static bool Line_StartExchange(trk_line_t *line, trk_node_t *node, const uint8_t *frame, size_t len,
+                               bool copy, uint8_t prio, uint32_t enq_cyc, uint32_t now)
+{
+    /* Длинный ответ ('T' — 27 байт) дольше идёт по линии: таймаут и замер RTT
+       приводим к ответу 'S', иначе на медленной линии 'T' всегда будет таймаутом */
+    uint32_t reply_len = Reply_FrameLen(line, frame[3]);
+    uint32_t baud      = line->cfg->huart->Init.BaudRate;
+    line->reply_extra_us = (baud > 0 && reply_len > GKL_STATUS_REPLY_LEN)
+                         ? (uint32_t)(((uint64_t)(reply_len - GKL_STATUS_REPLY_LEN) * UART_CHAR_BITS * 1000000u) / baud)
+                         : 0u;
+
+    line->active        = node;
+    line->cur_prio      = prio;
+    line->cur_enq_cyc   = enq_cyc;
+    line->t_deadline_ms = now + TX_TIMEOUT_MS;
+    line->state         = LINE_TX_PENDING;
+
+#if TRK_BUS_FRAME_LOG
+    Log_Frame("TX", line->num, frame, len);
+#endif
+
+    /* Не блокирует: кадр уходит по DMA, окончание придёт в Line_OnTxDone.
+       Константные кадры DMA читает прямо из флеша, собранные — из копии в очереди */
+    bool queued = copy ? TRK_UART_Send(&line->uart, frame, len)
+                       : TRK_UART_SendConst(&line->uart, frame, len);
+    if (!queued) {
+        line->active = NULL;
+        line->state  = LINE_IDLE;
+        line->stats.tx_drops++;
+        return false;
+    }
+    return true;
+}
+
+static bool Line_SendPoll(trk_line_t *line, trk_node_t *node, uint32_t now)
+{
+    /* Что спросить — решает транзакция снятого пистолета: обычно 'S', во время налива
+       и после — 'L'/'R'/'T' только про него. Остальные пистолеты опросов не тратят */
+    uint8_t        nozzle = 0;
+    gkl_cmd_id_t   cmd    = GKL_CMD_STATUS;
+    const uint8_t *frame  = node->poll_frame;
+    size_t         len    = node->poll_frame_len;
+    uint8_t        buf[GKL_CMD_FRAME_MAX];
+    trk_txn_t     *txn    = NULL;
+    trk_nozzle_t  *asked  = NULL;
+    uint8_t        phase  = 0;
+
+    if (node->active_nozzle) {
+        txn   = &node->nozzles[node->active_nozzle - 1u].txn;
+        phase = txn->poll_phase;
+        cmd   = TRK_Txn_NextRequest(txn, &nozzle);
+    } else if (node->miss_streak == 0) {
+        /* ТРК свободна — один раз дочитываем цену пистолетов, которые уже видели */
+        for (uint8_t n = 0; n < TRK_NODE_MAX_NOZZLES; n++) {
+            trk_nozzle_t *nz = &node->nozzles[n];
+            if ((nz->flags & (TRK_NOZZLE_SEEN | TRK_NOZZLE_PRICE | TRK_NOZZLE_PRICE_ASKED)) == TRK_NOZZLE_SEEN) {
+                nz->flags |= TRK_NOZZLE_PRICE_ASKED;
+                asked  = nz;
+                cmd    = GKL_CMD_PRICE;
+                nozzle = (uint8_t)(n + 1u);
+                break;
+            }
+        }
+    }
+
+    if (cmd == GKL_CMD_TOTALS || cmd == GKL_CMD_PRICE) {
+        len   = GKL_Encode_Nozzle(node->addr, cmd, nozzle, buf, sizeof(buf));
+        frame = buf;
+    } else if (cmd != GKL_CMD_STATUS) {
+        frame = GKL_Encode_Template(node->addr, cmd, &len);
+    }
+    if (!frame || len == 0) {
+        line->active = node;            /* только чтобы перенести его опрос */
+        Line_FinishTransaction(line, now);
+        return false;
+    }
+
+    if (!Line_StartExchange(line, node, frame, len, frame == buf, TRK_PRIO_COUNT, 0u, now)) {
+        /* Запрос не ушёл — в следующий раз спросим то же самое */
+        if (txn)   txn->poll_phase = phase;
+        if (asked) asked->flags &= (uint8_t)~TRK_NOZZLE_PRICE_ASKED;
+        return false;
+    }
+    line->stats.polls++;
+    node->polls++;
+    return true;
+}
+
+/* Команда из очереди — старший непустой класс. Сама команда не вытесняет
+   обмен на линии: уходит в первой же паузе, раньше любого опроса */
+static bool Line_SendCommand(trk_line_t *line, uint32_t now)
+{
+    for (uint8_t prio = 0; prio < TRK_PRIO_COUNT; prio++)
+    {
+        trk_cmd_queue_t *q = &line->cmdq[prio];
+        if (q->head == q->tail) continue;
+
+        trk_cmd_t  *cmd  = &q->q[q->tail & q->mask];
+        trk_node_t *node = TRK_Bus_FindNode(line, cmd->addr);
+        const uint8_t *frame = cmd->ext ? cmd->ext : cmd->data;
+
+        /* UART занят — команда остаётся первой в очереди до следующей паузы */
+        if (!Line_StartExchange(line, node, frame, cmd->len, cmd->ext == NULL, prio, cmd->t_enq_cyc, now))
+            return true;
+        q->tail++;
+        line->stats.cmds++;
+        if (node) node->polls++;
+        return true;
+    }
+    return false;
+}
+
+/* Последний бит запроса ушёл в линию (ISR): с этого момента ждём ответ */
+static void Line_OnTxDone(void *ctx)
+{
+    trk_line_t *line = (trk_line_t *)ctx;
+    if (line->state == LINE_TX_PENDING) {
+        uint32_t timeout_ms = (line->active ? line->active->reply_timeout_ms : REPLY_TIMEOUT_MS)
+                            + (line->reply_extra_us + 999u) / 1000u;
+        line->t_tx_done_cyc = line->uart.tx_done_cyc;
+        line->t_deadline_ms = HAL_GetTick() + timeout_ms;
+        /* Стоп дошёл до ТРК: от постановки в очередь до последнего бита в линии */
+        if (line->cur_prio == TRK_PRIO_STOP) {
+            uint32_t cyc_per_us = SystemCoreClock / 1000000u;
+            uint32_t lat_us = cyc_per_us ? (line->t_tx_done_cyc - line->cur_enq_cyc) / cyc_per_us : 0u;
+            line->stats.stops++;
+            line->stats.stop_lat_last_us = lat_us;
+            if (lat_us > line->stats.stop_lat_max_us) line->stats.stop_lat_max_us = lat_us;
+        }
+        /* Всё, что было до конца запроса, к ответу не относится */
+        GKL_Parser_Reset(&line->parser);
+        line->state = LINE_WAIT_REPLY;
+    }
+}
+
+/* Парсер собрал кадр (ISR): первый после запроса — ответ, остальные до обработки не нужны */
+static void Line_OnFrame(void *ctx, const GKL_Frame *frame)
+{
+    trk_line_t *line = (trk_line_t *)ctx;
+    if (line->state != LINE_WAIT_REPLY) return;
+
+    line->reply       = *frame;
+    line->t_reply_cyc = TRK_UART_Cycles();
+    line->state       = LINE_REPLY_READY;   /* главный цикл проснётся из WFI сразу после ISR */
+    s_work_pending    = 1u;                 /* а если ещё не уснул — не уснёт */
+}
+
+/* Байты из DMA (ISR): собираем ответ сразу, не дожидаясь главного цикла.
+   USART и его DMA-потоки на одном приоритете — друг друга не вытесняют. */
+static void Line_OnRxBytes(void *ctx, const uint8_t *data, uint32_t len)
+{
+    trk_line_t *line = (trk_line_t *)ctx;
+    if (line->state != LINE_WAIT_REPLY) return;
+    GKL_Parser_ConsumeBuffer(&line->parser, data, len, Line_OnFrame, line);
+}
+
+/* Разрыв в линии (ISR): недобранный ответ уже не продолжится */
+static void Line_OnRxGap(void *ctx)
+{
+    trk_line_t *line = (trk_line_t *)ctx;
+    if (line->state != LINE_WAIT_REPLY) return;
+    GKL_Parser_OnGap(&line->parser);   /* считает сам, в parser.stats.gaps */
+}
+
+/* Ошибка приёма (ISR): в собранном кадре битый байт — выбрасываем его целиком,
+   следующий кадр подхватим с его STX. Приём при этом не останавливается. */
+static void Line_OnRxError(void *ctx, uint32_t errors)
+{
+    trk_line_t *line = (trk_line_t *)ctx;
+    (void)errors;
+    if (line->state != LINE_WAIT_REPLY || line->parser.idx == 0) return;
+    GKL_Parser_Reset(&line->parser);
+    line->stats.err_flushes++;
+}
+
+/* =========================
+ *  Пистолеты и их транзакции
+ * ========================= */
+static void Node_TxnStep(trk_line_t *line, trk_node_t *node, uint8_t n, const GKL_Reply *r, uint32_t now)
+{
+    trk_nozzle_t *nz  = &node->nozzles[n - 1u];
+    trk_txn_t    *txn = &nz->txn;
+    uint8_t       seq = txn->seq;
+    uint32_t      ev  = TRK_Txn_OnReply(txn, r, now, NULL);
+    /* Новая продажа — оценщик с нуля: скорость прошлого налива к ней не относится */
+    if (txn->seq != seq) TRK_Live_Reset(&nz->live);
+    TRK_Live_SetRunning(&nz->live, txn->state == TXN_FUELING);
+    if (ev & TXN_EV_STATE) {
+        Log_Proto("[t=%lu ms][%s][TXN] addr %u nozzle %u #%u %s vol=%lu.%02lu money=%lu.%02lu\r\n",
+                  (unsigned long)now, line->cfg->tag, (unsigned)node->addr, (unsigned)n,
+                  (unsigned)txn->seq, TRK_Txn_StateName((trk_txn_state_t)txn->state),
+                  (unsigned long)(txn->volume_cl / 100u), (unsigned long)(txn->volume_cl % 100u),
+                  (unsigned long)(txn->money_kop / 100u), (unsigned long)(txn->money_kop % 100u));
+    }
+}
+
+/* Ответ — тому пистолету, о котором он: 'L'/'R'/'T'/'C'/'Z' несут номер сами,
+   'S' несёт номер снятого, а '0' относится к тому, что был снят до этого */
+static void Node_OnReply(trk_line_t *line, trk_node_t *node, const GKL_Reply *r, uint32_t now)
+{
+    uint8_t       n  = 0;
+    trk_nozzle_t *nz = NULL;
+
+    switch (r->cmd)
+    {
+        case 'S':
+        case 'D':
+        {
+            uint8_t status = r->u.status.status;
+            uint8_t raw    = r->u.status.nozzle;
+            n = Node_NozzleIndex(raw);
+            if (status == GKL_TRK_OFF) {
+                n = node->active_nozzle;
+                if (!n) return;              /* свободна и была свободна — транзакциям нечего делать */
+            } else if (n == 0) {
+                /* Номера нет ('0' / не цифра) или он вне TRK_NODE_MAX_NOZZLES: снятие не теряем —
+                   остаётся на текущем пистолете; без него ТРК без номеров — однопистолетная */
+                n = node->active_nozzle;
+                if (!n && (uint8_t)(raw - '1') > 8u) n = 1u;
+            } else if (node->active_nozzle && node->active_nozzle != n) {
+                /* Сменился пистолет: у прежнего транзакция кончилась, как при '0' */
+                GKL_Reply off = *r;
+                off.u.status.status = GKL_TRK_OFF;
+                off.u.status.nozzle = (uint8_t)('0' + node->active_nozzle);
+                Node_TxnStep(line, node, node->active_nozzle, &off, now);
+            }
+            if (status == GKL_TRK_OFF) {
+                node->active_nozzle = 0;
+            } else if (n) {
+                node->active_nozzle = n;
+                node->nozzles[n - 1u].flags = (uint8_t)((node->nozzles[n - 1u].flags | TRK_NOZZLE_SEEN)
+                                                        & ~TRK_NOZZLE_PRICE_ASKED);
+            }
+            break;
+        }
+        case 'L':
+            n = Node_NozzleIndex(r->u.volume.nozzle);
+            if (!n) n = node->active_nozzle;
+            if (n) {
+                node->nozzles[n - 1u].volume_cl = r->u.volume.volume_cl;
+                TRK_Live_OnVolume(&node->nozzles[n - 1u].live, r->u.volume.volume_cl, now);
+            }
+            break;
+        case 'R':
+            n = Node_NozzleIndex(r->u.money.nozzle);
+            if (!n) n = node->active_nozzle;
+            if (n) {
+                node->nozzles[n - 1u].money_kop = r->u.money.money_kop;
+                TRK_Live_OnMoney(&node->nozzles[n - 1u].live, r->u.money.money_kop, now);
+            }
+            break;
+        case 'T':
+            n = Node_NozzleIndex(r->u.totals.nozzle);
+            if (n) {
+                nz = &node->nozzles[n - 1u];
+                nz->totals_cl  = r->u.totals.volume_cl;
+                nz->totals_kop = r->u.totals.money_kop;
+                nz->flags     |= TRK_NOZZLE_TOTALS;
+            }
+            break;
+        case 'C':
+            n = Node_NozzleIndex(r->u.price.nozzle);
+            if (n) {
+                nz = &node->nozzles[n - 1u];
+                if (!(nz->flags & TRK_NOZZLE_PRICE) || nz->price_kop != r->u.price.price_kop ||
+                    nz->grade != r->u.price.grade) {
+                    Log_Proto("[t=%lu ms][%s] addr %u nozzle %u grade %u price %lu.%02lu\r\n",
+                              (unsigned long)now, line->cfg->tag, (unsigned)node->addr, (unsigned)n,
+                              (unsigned)r->u.price.grade,
+                              (unsigned long)(r->u.price.price_kop / 100u),
+                              (unsigned long)(r->u.price.price_kop % 100u));
+                }
+                nz->price_kop = r->u.price.price_kop;
+                nz->grade     = r->u.price.grade;
+                nz->flags    |= TRK_NOZZLE_PRICE | TRK_NOZZLE_SEEN;
+            }
+            if (!n) line->stats.unrouted++;
+            return;   /* в транзакцию цена не идёт */
+        case 'Z':
+            n = Node_NozzleIndex(r->u.preset.nozzle);
+            if (!n) n = node->active_nozzle;
+            break;
+        default:
+            return;
+    }
+    if (!n) {
+        line->stats.unrouted++;             /* ни номера в ответе, ни снятого пистолета */
+        return;
+    }
+    Node_TxnStep(line, node, n, r, now);
+}
+
+/* =========================
+ *  Обработка полного ответа
+ * ========================= */
+static void Line_HandleCompleteFrame(trk_line_t *line)
+{
+    trk_node_t      *node  = line->active;
+    const GKL_Frame *frame = &line->reply;
+    uint8_t          addr  = frame->slave_addr;
+
+#if TRK_BUS_FRAME_LOG
+    /* XOR у принятого кадра сошёлся, поэтому пересборка даёт ровно те байты, что были в линии */
+    uint8_t raw[GKL_MAX_FRAME_SIZE];
+    size_t  raw_len = gkl_build_frame(addr, frame->cmd, frame->data, frame->data_len, raw, sizeof(raw));
+    Log_Frame("RX", line->num, raw, raw_len);
+#endif
+
+    /* Строгая очерёдность: ответ засчитывается только тому, кого спросили */
+    if (!node || addr != node->addr) {
+        line->stats.foreign++;
+        Log_Proto("[t=%lu ms][%s] reply from addr %u, expected %u\r\n",
+                  (unsigned long)HAL_GetTick(), line->cfg->tag,
+                  (unsigned)addr, node ? (unsigned)node->addr : 0u);
+        return;
+    }
+
+    line->stats.replies++;
+    node->replies++;
+
+    /* Последний байт ответа — за один символ до IDLE, на котором он был выгружен из DMA */
+    uint32_t cyc_per_us = SystemCoreClock / 1000000u;
+    uint32_t baud       = line->cfg->huart->Init.BaudRate;
+    if (cyc_per_us > 0 && baud > 0) {
+        uint32_t rtt_us  = (line->t_reply_cyc - line->t_tx_done_cyc) / cyc_per_us;
+        uint32_t char_us = (UART_CHAR_BITS * 1000000u) / baud + line->reply_extra_us;
+        Node_OnRttSample(node, (rtt_us > char_us) ? rtt_us - char_us : rtt_us);
+    }
+
+    /* Возврат после «offline» в лог попадёт событием TRK_CHG_ONLINE */
+    node->miss_streak = 0;
+
+    GKL_Reply reply;
+    if (!GKL_DecodeWith(line->parser.dialect, addr, frame->cmd, frame->data, frame->data_len, &reply)) {
+        Log_Proto("[t=%lu ms][%s] addr %u: reply '%c' not decoded\r\n",
+                  (unsigned long)HAL_GetTick(), line->cfg->tag, (unsigned)addr, frame->cmd);
+        return;
+    }
+
+    /* Кэш состояния: наружу (лог, дисплей) — только изменения, см. Bus_LogStateEvents */
+    if (TRK_State_OnReply((uint8_t)(line->num - 1u), &reply, HAL_GetTick()) & TRK_CHG_STATUS) {
+        line->stats.status_changes++;
+    }
+    /* Период опроса планировщик берёт со своей копии статуса */
+    if (reply.cmd == 'S') {
+        node->status = reply.u.status.status;
+        node->nozzle = reply.u.status.nozzle;
+    }
+    Node_OnReply(line, node, &reply, HAL_GetTick());
+}
+
+/* Изменения состояния ТРК — по строке на событие; работа по числу изменений, а не опросов */
+static void Bus_LogStateEvents(void)
+{
+    trk_state_event_t ev;
+    while (TRK_State_PopEvent(&ev)) {
+        Log_Proto("[t=%lu ms][%s][EV] addr %u chg=%02X st='%c' nozzle='%c' vol=%lu.%02lu money=%lu.%02lu %s\r\n",
+                  (unsigned long)ev.t_change_ms,
+                  (ev.line < s_line_count) ? s_lines[ev.line].cfg->tag : "?",
+                  (unsigned)ev.addr, (unsigned)ev.changed,
+                  ev.status ? ev.status : '-', ev.nozzle ? ev.nozzle : '-',
+                  (unsigned long)(ev.volume_cl / 100u), (unsigned long)(ev.volume_cl % 100u),
+                  (unsigned long)(ev.money_kop / 100u), (unsigned long)(ev.money_kop % 100u),
+                  ev.online ? "online" : "offline");
+    }
+}
+
+/* Закрытые транзакции налива — в протокольный лог одной строкой */
+static void Bus_LogTxnRecords(void)
+{
+    trk_txn_record_t rec;
+    while (TRK_Txn_PopRecord(&rec)) {
+        Log_Proto("[t=%lu ms][TXN] addr %u #%u nozzle '%c' vol=%lu.%02lu money=%lu.%02lu preset=%lu "
+                  "dur=%lu ms totals=%lu.%02lu%s\r\n",
+                  (unsigned long)HAL_GetTick(), (unsigned)rec.addr, (unsigned)rec.seq,
+                  rec.nozzle ? rec.nozzle : '-',
+                  (unsigned long)(rec.volume_cl / 100u), (unsigned long)(rec.volume_cl % 100u),
+                  (unsigned long)(rec.money_kop / 100u), (unsigned long)(rec.money_kop % 100u),
+                  (rec.flags & TXN_REC_PRESET) ? (unsigned long)rec.preset : 0ul,
+                  (unsigned long)rec.duration_ms,
+                  (unsigned long)(rec.totals_cl / 100u), (unsigned long)(rec.totals_cl % 100u),
+                  (rec.flags & TXN_REC_ABORTED) ? " ABORTED" : "");
+    }
+}
+
+/* =========================
+ *  Выгрузка принятого из кольца
+ * ========================= */
+static void Line_DrainRx(trk_line_t *line)
+{
+    uint8_t chunk[32];
+    size_t  n;
+    bool    gap;
+
+    /* Ответ уже собран в ISR; кольцо — сырой поток для лога, пачками
+       до отметок разрыва, чтобы в логе было видно, где линия замолчала.
+       Без TRK_BUS_FRAME_LOG кольцо просто освобождается */
+    for (;;)
+    {
+        n = TRK_UART_ReadUntilGap(&line->uart, chunk, sizeof(chunk), &gap);
+#if TRK_BUS_FRAME_LOG
+        if (n > 0) {
+            Log_Frame("RXc", line->num, chunk, n);
+        }
+#endif
+        if (n == 0 && !gap) break;
+    }
+}
+
+/* =========================
+ *  Шаг конечного автомата (каждая линия)
+ * ========================= */
+static void Line_Step(trk_line_t *line)
+{
+    uint32_t now = HAL_GetTick();
+
+    /* Готовый ответ — раньше сырого потока: задержка до следующего запроса не зависит от RXc */
+    if (line->state != LINE_REPLY_READY) {
+        Line_DrainRx(line);
+    }
+    TRK_UART_CheckRx(&line->uart);
+
+    switch (line->state)
+    {
+        case LINE_IDLE:
+        {
+            /* линия отдохнула? — сначала команды по приоритету, потом тот, кому пора на опрос */
+            if ((int32_t)(now - line->t_bus_free_ms) < 0) break;
+            if (Line_SendCommand(line, now)) break;
+            uint8_t     cursor = line->cursor;
+            trk_node_t *node   = Line_PickNextNode(line, now);
+            /* Не ушёл — круг не сдвигаем: тот же узел первым на следующем проходе */
+            if (node && !Line_SendPoll(line, node, now)) line->cursor = cursor;
+            break;
+        }
+
+        case LINE_TX_PENDING:
+        {
+            /* Переход в WAIT_REPLY делает ISR; здесь только страховка от потерянного TC */
+            bool tx_lost = false;
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            if (line->state == LINE_TX_PENDING && (int32_t)(now - line->t_deadline_ms) >= 0) {
+                line->state = LINE_IDLE;
+                tx_lost = true;
+            }
+            __set_PRIMASK(primask);
+            if (tx_lost) {
+                line->stats.tx_timeouts++;
+                Log_Proto("[t=%lu ms][%s][TX TIMEOUT] no TC in %u ms\r\n",
+                          (unsigned long)now, line->cfg->tag, (unsigned)TX_TIMEOUT_MS);
+                Line_FinishTransaction(line, now);
+            }
+            break;
+        }
+
+        case LINE_REPLY_READY:
+        {
+            /* ISR собрал полный кадр — обрабатываем */
+            uint32_t cyc_per_us = SystemCoreClock / 1000000u;
+            if (cyc_per_us > 0) {
+                uint32_t lat_us = (TRK_UART_Cycles() - line->t_reply_cyc) / cyc_per_us;
+                if (lat_us > line->stats.ready_lat_max_us) line->stats.ready_lat_max_us = lat_us;
+            }
+            Line_HandleCompleteFrame(line);
+            /* линия сразу свободна для следующего узла; этому — следующий опрос по его статусу */
+            Line_FinishTransaction(line, now);
+            Line_DrainRx(line);
+            break;
+        }
+
+        case LINE_WAIT_REPLY:
+        {
+            /* Кадр собирает ISR; здесь только таймаут. Проверка и выход из WAIT_REPLY —
+               атомарно, иначе ISR может успеть выставить REPLY_READY между ними. */
+            bool timed_out = false;
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            if (line->state == LINE_WAIT_REPLY && (int32_t)(now - line->t_deadline_ms) >= 0) {
+                line->state = LINE_IDLE;
+                timed_out = true;
+            }
+            __set_PRIMASK(primask);
+
+            /* таймаут ожидания ответа — стоит только этот узел, остальные идут дальше */
+            if (timed_out)
+            {
+                trk_node_t *node = line->active;
+                line->stats.timeouts++;
+                if (node) {
+                    uint16_t waited_ms = node->reply_timeout_ms;
+                    node->timeouts++;
+                    if (node->miss_streak < 0xFFu) node->miss_streak++;
+                    Node_OnReplyTimeout(node);
+                    if (node->miss_streak == NODE_OFFLINE_MISSES) {
+                        TRK_State_SetOnline((uint8_t)(line->num - 1u), node->addr, false, now);
+                    }
+                    /* Про мёртвую ТРК пишем один раз, а не каждый цикл */
+                    if (node->miss_streak <= NODE_OFFLINE_MISSES) {
+                        Log_Proto("[t=%lu ms][%s][TIMEOUT] addr %u: no full frame in %u ms%s\r\n",
+                                  (unsigned long)now, line->cfg->tag, (unsigned)node->addr,
+                                  (unsigned)waited_ms,
+                                  (node->miss_streak == NODE_OFFLINE_MISSES) ? ", offline" : "");
+                    }
+                }
+                Line_FinishTransaction(line, now);
+            }
+            break;
+        }
+
+        default:
+            line->state = LINE_IDLE;
+            break;
+    }
+}
+
+/* =========================
+ *  Менеджер линий
+ * ========================= */
+void TRK_Bus_Init(const trk_line_cfg_t* cfg, size_t count)
+{
+    if (!cfg) count = 0;
+    if (count > TRK_BUS_MAX_LINES) {
+        Log_System("TRK bus: %u lines configured, only %u supported\r\n",
+                   (unsigned)count, (unsigned)TRK_BUS_MAX_LINES);
+        count = TRK_BUS_MAX_LINES;
+    }
+
+    uint32_t now = HAL_GetTick();
+    s_line_count = count;
+    TRK_State_Init();
+    s_t_next_stats_ms = now + STATS_PERIOD_MS;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        trk_line_t *line = &s_lines[i];
+        memset(line, 0, sizeof(*line));
+        line->cfg            = &cfg[i];
+        line->num            = (uint8_t)(i + 1u);
+        line->state          = LINE_IDLE;
+        line->stats.window_start_ms = now;
+        line->cur_prio       = TRK_PRIO_COUNT;
+        line->cmdq[TRK_PRIO_STOP].q    = line->stop_slots;
+        line->cmdq[TRK_PRIO_STOP].mask = (uint8_t)(TRK_CMD_STOP_QUEUE_LEN - 1u);
+        for (uint8_t prio = TRK_PRIO_STOP + 1u; prio < TRK_PRIO_COUNT; prio++) {
+            line->cmdq[prio].q    = line->cmd_slots[prio - 1u];
+            line->cmdq[prio].mask = (uint8_t)(TRK_CMD_QUEUE_LEN - 1u);
+        }
+        GKL_Parser_Init(&line->parser);
+        GKL_Parser_SetDialect(&line->parser, cfg[i].dialect);
+
+        for (uint8_t addr = 1; addr <= TRK_LINE_MAX_NODES; addr++) {
+            if (cfg[i].addr_mask & TRK_ADDR(addr)) {
+                Node_Init(&line->nodes[line->node_count++], addr, now + cfg[i].start_delay_ms);
+            }
+        }
+        line->cursor = (uint8_t)(line->node_count ? line->node_count - 1u : 0u);
+
+        if (TRK_UART_Init(&line->uart, cfg[i].huart, &cfg[i].rx_dma, &cfg[i].tx_dma,
+                          cfg[i].de.port ? &cfg[i].de : NULL) != HAL_OK)
+            Log_System("%s: UART/DMA/DE start failed\r\n", cfg[i].tag);
+        if (TRK_UART_EnableGapDetect(&line->uart, INTERBYTE_GAP_BITS) != HAL_OK)
+            Log_System("%s: receiver timeout not enabled\r\n", cfg[i].tag);
+        TRK_UART_SetTxDoneCallback(&line->uart, Line_OnTxDone, line);
+        TRK_UART_SetRxCallbacks(&line->uart, Line_OnRxBytes, Line_OnRxGap, Line_OnRxError, line);
+    }
+}
+
+void TRK_Bus_Process(void)
+{
+    /* Снимаем до обхода: что придёт во время обхода, оставит флаг поднятым */
+    s_work_pending = 0u;
+    for (size_t i = 0; i < s_line_count; i++) {
+        Line_Step(&s_lines[i]);
+    }
+    Bus_LogStateEvents();
+    Bus_LogTxnRecords();
+
+    uint32_t now = HAL_GetTick();
+    if ((int32_t)(now - s_t_next_stats_ms) >= 0) {
+        s_t_next_stats_ms = now + STATS_PERIOD_MS;
+        TRK_Bus_LogStats();
+    }
+}
+
+bool TRK_Bus_WorkPending(void)
+{
+    return s_work_pending != 0u;
+}
+
+size_t TRK_Bus_LineCount(void)
+{
+    return s_line_count;
+}
+
+trk_line_t* TRK_Bus_GetLine(size_t index)
+{
+    return (index < s_line_count) ? &s_lines[index] : NULL;
+}
+
+trk_line_t* TRK_Bus_FindLineByAddr(uint8_t slave_addr)
+{
+    if (slave_addr < 1 || slave_addr > TRK_LINE_MAX_NODES) return NULL;
+    for (size_t i = 0; i < s_line_count; i++) {
+        if (s_lines[i].cfg->addr_mask & TRK_ADDR(slave_addr)) return &s_lines[i];
+    }
+    return NULL;
+}
+
+trk_node_t* TRK_Bus_FindNode(trk_line_t* line, uint8_t slave_addr)
+{
+    if (!line) return NULL;
+    for (uint8_t i = 0; i < line->node_count; i++) {
+        if (line->nodes[i].addr == slave_addr) return &line->nodes[i];
+    }
+    return NULL;
+}
+
+/* Убирает из кольца команды на адрес, порядок остальных сохраняется. Возвращает, сколько снято */
+static uint32_t CmdQueue_Purge(trk_cmd_queue_t *q, uint8_t slave_addr)
+{
+    uint8_t keep = q->tail;
+    for (uint8_t k = q->tail; k != q->head; k++) {
+        if (q->q[k & q->mask].addr == slave_addr) continue;
+        if (keep != k) q->q[keep & q->mask] = q->q[k & q->mask];
+        keep++;
+    }
+    uint32_t purged = (uint8_t)(q->head - keep);
+    q->head = keep;
+    return purged;
+}
+
+bool TRK_Bus_QueueCommand(uint8_t slave_addr, trk_cmd_prio_t prio,
+                          const uint8_t* frame, size_t len, bool in_flash)
+{
+    trk_line_t *line = TRK_Bus_FindLineByAddr(slave_addr);
+    if (!line || !frame || len < 4u || len > GKL_CMD_FRAME_MAX || prio >= TRK_PRIO_COUNT) return false;
+
+    trk_cmd_queue_t *q = &line->cmdq[prio];
+    if (prio == TRK_PRIO_STOP) {
+        /* Пуск или доза, ждущие за стопом, снова запустили бы насос — снимаем */
+        for (uint8_t lower = TRK_PRIO_STOP + 1u; lower < TRK_PRIO_COUNT; lower++) {
+            line->stats.cmd_purged += CmdQueue_Purge(&line->cmdq[lower], slave_addr);
+        }
+        for (uint8_t k = q->tail; k != q->head; k++) {
+            if (q->q[k & q->mask].addr == slave_addr) return true;  /* стоп уже ждёт */
+        }
+    }
+    if ((uint8_t)(q->head - q->tail) > q->mask) {
+        line->stats.cmd_dropped++;
+        Log_Proto("[t=%lu ms][%s] command queue %u full, '%c' to addr %u dropped\r\n",
+                  (unsigned long)HAL_GetTick(), line->cfg->tag, (unsigned)prio,
+                  frame[3], (unsigned)slave_addr);
+        return false;
+    }
+
+    trk_cmd_t *cmd = &q->q[q->head & q->mask];
+    cmd->t_enq_cyc = TRK_UART_Cycles();
+    cmd->addr      = slave_addr;
+    cmd->len       = (uint8_t)len;
+    cmd->ext       = in_flash ? frame : NULL;
+    if (!in_flash) memcpy(cmd->data, frame, len);
+    q->head++;
+    s_work_pending = 1u;
+
+    /* Линия стоит в паузе — не ждём следующего прохода главного цикла */
+    uint32_t now = HAL_GetTick();
+    if (line->state == LINE_IDLE && (int32_t)(now - line->t_bus_free_ms) >= 0) {
+        Line_SendCommand(line, now);
+    }
+    return true;
+}
+
+trk_line_t* TRK_Bus_FindLineByHandle(const UART_HandleTypeDef* huart)
+{
+    for (size_t i = 0; i < s_line_count; i++) {
+        if (s_lines[i].cfg->huart == huart) return &s_lines[i];
+    }
+    return NULL;
+}
+
+void TRK_Bus_LogStats(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    for (size_t i = 0; i < s_line_count; i++)
+    {
+        trk_line_t *line = &s_lines[i];
+
+        /* Опросов в секунду за прошедшее окно — по нему считаем, сколько ТРК влезет в линию */
+        uint32_t elapsed = now - line->stats.window_start_ms;
+        if (elapsed > 0) {
+            line->stats.polls_per_sec_x10 =
+                ((line->stats.polls - line->stats.window_polls) * 10000u) / elapsed;
+        }
+        line->stats.window_polls    = line->stats.polls;
+        line->stats.window_start_ms = now;
+
+        /* Занятость линии: сколько бит реально прошло по проводу (запросы + ответы)
+           против того, сколько могло пройти за окно на этой скорости */
+        uint32_t bytes = line->uart.tx_bytes + line->uart.rx_bytes;
+        uint32_t baud  = line->cfg->huart->Init.BaudRate;
+        if (elapsed > 0 && baud > 0) {
+            uint64_t bits = (uint64_t)(bytes - line->stats.window_bytes) * UART_CHAR_BITS;
+            line->stats.util_permille = (uint32_t)((bits * 1000u * 1000u) / ((uint64_t)elapsed * baud));
+        }
+        line->stats.window_bytes = bytes;
+
+        uint8_t online = 0, active = 0;
+        for (uint8_t n = 0; n < line->node_count; n++) {
+            if (line->nodes[n].miss_streak < NODE_OFFLINE_MISSES) online++;
+            if (line->nodes[n].poll_interval_ms == POLL_ACTIVE_MS) active++;
+        }
+
+        Log_Proto("[t=%lu ms][%s][STATS]%s nodes=%u/%u active=%u polls/s=%lu.%lu bus=%lu.%lu%% "
+                  "ready_lat_max=%lu us polls=%lu replies=%lu "
+                  "timeouts=%lu tx_to=%lu tx_drops=%lu foreign=%lu unrouted=%lu st_chg=%lu rx=%lu drop=%lu txq_drop=%lu\r\n",
+                  (unsigned long)now, line->cfg->tag, line->cfg->saturate ? "[SAT]" : "",
+                  (unsigned)online, (unsigned)line->node_count, (unsigned)active,
+                  (unsigned long)(line->stats.polls_per_sec_x10 / 10u),
+                  (unsigned long)(line->stats.polls_per_sec_x10 % 10u),
+                  (unsigned long)(line->stats.util_permille / 10u),
+                  (unsigned long)(line->stats.util_permille % 10u),
+                  (unsigned long)line->stats.ready_lat_max_us,
+                  (unsigned long)line->stats.polls, (unsigned long)line->stats.replies,
+                  (unsigned long)line->stats.timeouts, (unsigned long)line->stats.tx_timeouts,
+                  (unsigned long)line->stats.tx_drops,
+                  (unsigned long)line->stats.foreign, (unsigned long)line->stats.unrouted,
+                  (unsigned long)line->stats.status_changes,
+                  (unsigned long)line->uart.rx_bytes, (unsigned long)line->uart.rx_dropped,
+                  (unsigned long)line->uart.tx_dropped);
+        line->stats.ready_lat_max_us = 0;   /* максимум — за период */
+
+        /* Цена ISR USART за период: снимаем и обнуляем атомарно, ISR пишет те же поля */
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t isr_calls = line->uart.isr_calls;
+        uint32_t isr_sum   = line->uart.isr_cyc_sum;
+        uint32_t isr_max   = line->uart.isr_cyc_max;
+        line->uart.isr_calls   = 0;
+        line->uart.isr_cyc_sum = 0;
+        line->uart.isr_cyc_max = 0;
+        __set_PRIMASK(primask);
+
+        Log_Proto("[t=%lu ms][%s][UART] %s isr=%lu avg=%lu max=%lu cyc err ore=%lu fe=%lu ne=%lu pe=%lu "
+                  "dma=%lu rearm=%lu flush=%lu gaps=%lu gap_drop=%lu\r\n",
+                  (unsigned long)now, line->cfg->tag, TRK_UART_LEAN_ISR ? "lean" : "hal",
+                  (unsigned long)isr_calls, (unsigned long)(isr_calls ? isr_sum / isr_calls : 0u),
+                  (unsigned long)isr_max,
+                  (unsigned long)line->uart.err_ore, (unsigned long)line->uart.err_fe,
+                  (unsigned long)line->uart.err_ne, (unsigned long)line->uart.err_pe,
+                  (unsigned long)line->uart.err_dma, (unsigned long)line->uart.rx_rearms,
+                  (unsigned long)line->stats.err_flushes,
+                  (unsigned long)line->uart.rx_gaps, (unsigned long)line->uart.gaps_dropped);
+
+        /* Команды и стоп: худшая задержка стопа — с запуска, не за период */
+        Log_Proto("[t=%lu ms][%s][CMD] sent=%lu drop=%lu purged=%lu stops=%lu stop_lat last=%lu max=%lu us\r\n",
+                  (unsigned long)now, line->cfg->tag,
+                  (unsigned long)line->stats.cmds, (unsigned long)line->stats.cmd_dropped,
+                  (unsigned long)line->stats.cmd_purged,
+                  (unsigned long)line->stats.stops, (unsigned long)line->stats.stop_lat_last_us,
+                  (unsigned long)line->stats.stop_lat_max_us);
+
+        /* Парсер линии: счётчики пишет ISR, читаем по одному слову — для лога достаточно */
+        Log_Proto("[t=%lu ms][%s][GKL] frames=%lu csum=%lu ovf=%lu gaps=%lu\r\n",
+                  (unsigned long)now, line->cfg->tag,
+                  (unsigned long)line->parser.stats.frames,
+                  (unsigned long)line->parser.stats.checksum_errors,
+                  (unsigned long)line->parser.stats.overflows,
+                  (unsigned long)line->parser.stats.gaps);
+
+        for (uint8_t n = 0; n < line->node_count; n++) {
+            const trk_node_t *node = &line->nodes[n];
+            if (node->srtt_us == 0) continue;
+            Log_Proto("[t=%lu ms][%s][RTT] addr %u srtt=%lu.%02lu ms var=%lu.%02lu max=%lu.%02lu "
+                      "timeout=%u ms miss=%u\r\n",
+                      (unsigned long)now, line->cfg->tag, (unsigned)node->addr,
+                      (unsigned long)(node->srtt_us / 1000u),   (unsigned long)(node->srtt_us % 1000u / 10u),
+                      (unsigned long)(node->rttvar_us / 1000u), (unsigned long)(node->rttvar_us % 1000u / 10u),
+                      (unsigned long)(node->rtt_max_us / 1000u), (unsigned long)(node->rtt_max_us % 1000u / 10u),
+                      (unsigned)node->reply_timeout_ms, (unsigned)node->miss_streak);
+        }
+    }
+
+    /* Очередь лога переполняется раньше линий — видно, когда логи врут пропусками */
+    uint32_t log_dropped = Log_Dropped();
+    if (log_dropped) {
+        Log_Proto("[t=%lu ms][LOG] lines dropped=%lu\r\n", (unsigned long)now, (unsigned long)log_dropped);
+    }
+}
@@ -0,0 +1,68 @@
+/* File: Core/Src/trk_live.c */
+#include "trk_live.h"
+#include <string.h>
+
+void TRK_Live_Reset(trk_live_t *lv)
+{
+    memset(lv, 0, sizeof(*lv));
+}
+
+void TRK_Live_SetRunning(trk_live_t *lv, bool running)
+{
+    if (lv->running == (uint8_t)running) return;
+    lv->running = (uint8_t)running;
+    /* Скорость прошлого налива (или простоя) к новому не относится */
+    lv->volume.rate_q16 = 0;
+    lv->money.rate_q16  = 0;
+}
+
+/* Замер: скорость по разнице с прошлым, сглаживание 1/4 — как srtt в линии */
+static void ctr_update(trk_live_ctr_t *c, uint32_t value, uint32_t now_ms, bool running)
+{
+    uint32_t dt = now_ms - c->t_ms;
+
+    if (!running || !c->valid || value < c->value) {
+        c->rate_q16 = 0;                   /* нет базы или счёт начался заново */
+    } else if (dt > 0u && dt <= TRK_LIVE_HORIZON_MS) {
+        uint32_t sample = (uint32_t)(((uint64_t)(value - c->value) << 16) / dt);
+        if (c->rate_q16 == 0u) {
+            c->rate_q16 = sample;
+        } else {
+            int32_t err = (int32_t)(sample - c->rate_q16) / 4;
+            c->rate_q16 = (uint32_t)((int32_t)c->rate_q16 + err);
+        }
+    } else if (dt > TRK_LIVE_HORIZON_MS) {
+        c->rate_q16 = 0;                   /* замеры слишком редкие — скорости не верим */
+    }
+    c->value = value;
+    c->t_ms  = now_ms;
+    c->valid = 1u;
+}
+
+static uint32_t ctr_estimate(const trk_live_ctr_t *c, bool running, uint32_t now_ms)
+{
+    if (!running || c->rate_q16 == 0u) return c->value;
+    uint32_t dt = now_ms - c->t_ms;
+    if (dt > TRK_LIVE_HORIZON_MS) dt = TRK_LIVE_HORIZON_MS;
+    return c->value + (uint32_t)(((uint64_t)c->rate_q16 * dt) >> 16);
+}
+
+void TRK_Live_OnVolume(trk_live_t *lv, uint32_t volume_cl, uint32_t now_ms)
+{
+    ctr_update(&lv->volume, volume_cl, now_ms, lv->running);
+}
+
+void TRK_Live_OnMoney(trk_live_t *lv, uint32_t money_kop, uint32_t now_ms)
+{
+    ctr_update(&lv->money, money_kop, now_ms, lv->running);
+}
+
+uint32_t TRK_Live_Volume(const trk_live_t *lv, uint32_t now_ms)
+{
+    return ctr_estimate(&lv->volume, lv->running, now_ms);
+}
+
+uint32_t TRK_Live_Money(const trk_live_t *lv, uint32_t now_ms)
+{
+    return ctr_estimate(&lv->money, lv->running, now_ms);
+}
@@ -0,0 +1,114 @@
+/* File: Core/Src/trk_state.c */
+#include "trk_state.h"
+#include <string.h>
+
+static trk_state_table_t s_tab;
+
+/* Накопленная маска изменений по записи и очередь записей с ненулевой маской.
+   Запись встаёт в очередь только при переходе маски из 0 — переполнения нет. */
+static uint8_t  s_dirty[TRK_BUS_MAX_LINES][TRK_LINE_MAX_NODES];
+static uint16_t s_pending[TRK_STATE_ENTRIES];
+static uint16_t s_pend_head;
+static uint16_t s_pend_tail;
+
+void TRK_State_Init(void)
+{
+    memset(&s_tab, 0, sizeof(s_tab));
+    memset(s_dirty, 0, sizeof(s_dirty));
+    s_pend_head = 0;
+    s_pend_tail = 0;
+}
+
+const trk_state_table_t* TRK_State_Table(void)
+{
+    return &s_tab;
+}
+
+static uint8_t mark(uint8_t line, uint8_t i, uint8_t chg, uint32_t now_ms)
+{
+    if (!chg) return 0u;
+    s_tab.t_change_ms[line][i] = now_ms;
+    if (s_dirty[line][i] == 0u) {
+        s_pending[s_pend_head % TRK_STATE_ENTRIES] = (uint16_t)(line * TRK_LINE_MAX_NODES + i);
+        s_pend_head++;
+    }
+    s_dirty[line][i] |= chg;
+    return chg;
+}
+
+/* Поле в таблицу; бит изменения — только если значение другое */
+#define STATE_SET(field, value, bit)                      \
+    do {                                                  \
+        if (s_tab.field[line][i] != (value)) {            \
+            s_tab.field[line][i] = (value);               \
+            chg |= (bit);                                 \
+        }                                                 \
+    } while (0)
+
+uint8_t TRK_State_OnReply(uint8_t line, const GKL_Reply* r, uint32_t now_ms)
+{
+    if (!r || line >= TRK_BUS_MAX_LINES || r->slave_addr < 1u || r->slave_addr > TRK_LINE_MAX_NODES)
+        return 0u;
+
+    uint8_t i   = (uint8_t)(r->slave_addr - 1u);
+    uint8_t chg = 0;
+
+    switch (r->cmd)
+    {
+        case 'S':
+        case 'D':
+            STATE_SET(status, r->u.status.status, TRK_CHG_STATUS);
+            STATE_SET(nozzle, r->u.status.nozzle, TRK_CHG_NOZZLE);
+            break;
+        case 'L':
+            STATE_SET(volume_cl, r->u.volume.volume_cl, TRK_CHG_VOLUME);
+            break;
+        case 'R':
+            STATE_SET(money_kop, r->u.money.money_kop, TRK_CHG_MONEY);
+            break;
+        default:
+            break;
+    }
+    /* Ответила — значит на линии */
+    STATE_SET(online, 1u, TRK_CHG_ONLINE);
+    return mark(line, i, chg, now_ms);
+}
+
+uint8_t TRK_State_SetOnline(uint8_t line, uint8_t addr, bool online, uint32_t now_ms)
+{
+    if (line >= TRK_BUS_MAX_LINES || addr < 1u || addr > TRK_LINE_MAX_NODES) return 0u;
+
+    uint8_t i   = (uint8_t)(addr - 1u);
+    uint8_t chg = 0;
+    STATE_SET(online, online ? 1u : 0u, TRK_CHG_ONLINE);
+    return mark(line, i, chg, now_ms);
+}
+
+bool TRK_State_PopEvent(trk_state_event_t* ev)
+{
+    while (s_pend_tail != s_pend_head)
+    {
+        uint16_t idx  = s_pending[s_pend_tail % TRK_STATE_ENTRIES];
+        uint8_t  line = (uint8_t)(idx / TRK_LINE_MAX_NODES);
+        uint8_t  i    = (uint8_t)(idx % TRK_LINE_MAX_NODES);
+        s_pend_tail++;
+
+        uint8_t chg = s_dirty[line][i];
+        s_dirty[line][i] = 0;
+        if (!chg) continue;
+
+        if (ev) {
+            ev->line        = line;
+            ev->addr        = (uint8_t)(i + 1u);
+            ev->changed     = chg;
+            ev->status      = s_tab.status[line][i];
+            ev->nozzle      = s_tab.nozzle[line][i];
+            ev->online      = s_tab.online[line][i];
+            ev->volume_cl   = s_tab.volume_cl[line][i];
+            ev->money_kop   = s_tab.money_kop[line][i];
+            ev->t_change_ms = s_tab.t_change_ms[line][i];
+        }
+        return true;
+    }
+    return false;
+}
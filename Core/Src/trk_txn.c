@@ -0,0 +1,251 @@
+/* File: Core/Src/trk_txn.c */
+#include "trk_txn.h"
+#include "gkl_frame.h"
+#include <string.h>
+
+/* Что осталось дочитать после окончания налива */
+#define NEED_VOLUME   0x01u
+#define NEED_MONEY    0x02u
+#define NEED_TOTALS   0x04u
+
+/* Кольцо закрытых транзакций: пишет и читает только главный цикл */
+static trk_txn_record_t s_records[TRK_TXN_RECORD_RING];
+static uint8_t          s_rec_head;
+static uint8_t          s_rec_tail;
+static uint32_t         s_rec_dropped;
+
+static void record_push(const trk_txn_record_t *rec)
+{
+    if ((uint8_t)(s_rec_head - s_rec_tail) >= TRK_TXN_RECORD_RING) {
+        s_rec_dropped++;
+        return;
+    }
+    s_records[s_rec_head & (TRK_TXN_RECORD_RING - 1u)] = *rec;
+    s_rec_head++;
+}
+
+bool TRK_Txn_PopRecord(trk_txn_record_t *rec)
+{
+    if (s_rec_head == s_rec_tail) return false;
+    if (rec) *rec = s_records[s_rec_tail & (TRK_TXN_RECORD_RING - 1u)];
+    s_rec_tail++;
+    return true;
+}
+
+uint32_t TRK_Txn_RecordsDropped(void)
+{
+    return s_rec_dropped;
+}
+
+const char* TRK_Txn_StateName(trk_txn_state_t s)
+{
+    switch (s)
+    {
+        case TXN_IDLE:       return "idle";
+        case TXN_NOZZLE_UP:  return "nozzle-up";
+        case TXN_AUTHORIZED: return "authorized";
+        case TXN_FUELING:    return "fueling";
+        case TXN_FINISHED:   return "finished";
+        case TXN_TOTALS:     return "totals";
+        case TXN_CLOSED:     return "closed";
+        default:             return "?";
+    }
+}
+
+void TRK_Txn_Init(trk_txn_t *t, uint8_t addr)
+{
+    memset(t, 0, sizeof(*t));
+    t->addr  = addr;
+    t->state = TXN_IDLE;
+}
+
+/* Пистолет ASCII '1'..'9' -> 1..9, иначе 0 */
+static uint8_t nozzle_num(uint8_t nozzle)
+{
+    return (nozzle >= '1' && nozzle <= '9') ? (uint8_t)(nozzle - '0') : 0u;
+}
+
+/* Новая транзакция: всё прошлое — в записи, здесь начинаем с нуля */
+static void txn_start(trk_txn_t *t, uint32_t now_ms)
+{
+    t->need       = 0;
+    t->poll_phase = 0;
+    t->flags      = 0;
+    t->volume_cl  = 0;
+    t->money_kop  = 0;
+    t->preset     = 0;
+    t->totals_cl  = 0;
+    t->t_start_ms = now_ms;
+    t->seq++;
+}
+
+static uint32_t txn_set_state(trk_txn_t *t, trk_txn_state_t s)
+{
+    if (t->state == (uint8_t)s) return 0u;
+    t->state      = (uint8_t)s;
+    t->poll_phase = 0;
+    return TXN_EV_STATE;
+}
+
+static uint32_t txn_close(trk_txn_t *t, uint32_t now_ms, trk_txn_record_t *out)
+{
+    trk_txn_record_t rec = {
+        .addr        = t->addr,
+        .nozzle      = t->nozzle,
+        .flags       = t->flags,
+        .seq         = t->seq,
+        .volume_cl   = t->volume_cl,
+        .money_kop   = t->money_kop,
+        .preset      = t->preset,
+        .t_start_ms  = t->t_start_ms,
+        .duration_ms = now_ms - t->t_start_ms,
+        .totals_cl   = t->totals_cl,
+    };
+    record_push(&rec);
+    if (out) *out = rec;
+    t->need = 0;
+    return txn_set_state(t, TXN_CLOSED) | TXN_EV_CLOSED;
+}
+
+/* Итог дочитан — за счётчиками или сразу в запись */
+static uint32_t txn_after_result(trk_txn_t *t, uint32_t now_ms, trk_txn_record_t *out)
+{
+    if (t->state == TXN_FINISHED && !(t->need & (NEED_VOLUME | NEED_MONEY))) {
+        if (!(t->need & NEED_TOTALS)) return txn_close(t, now_ms, out);
+        return txn_set_state(t, TXN_TOTALS);
+    }
+    if (t->state == TXN_TOTALS && !(t->need & NEED_TOTALS)) {
+        return txn_close(t, now_ms, out);
+    }
+    return 0u;
+}
+
+static uint32_t txn_on_status(trk_txn_t *t, uint8_t status, uint8_t nozzle,
+                              uint32_t now_ms, trk_txn_record_t *out)
+{
+    trk_txn_state_t st = (trk_txn_state_t)t->state;
+    bool fresh = (st == TXN_IDLE || st == TXN_CLOSED);
+    uint32_t ev = 0;
+
+    switch (status)
+    {
+        case GKL_TRK_OFF:
+            /* Налив был, а итог не дочитали — запись всё равно нужна, с пометкой */
+            if (st == TXN_FUELING || st == TXN_FINISHED) {
+                t->flags |= TXN_REC_ABORTED;
+                ev |= txn_close(t, now_ms, out);
+            } else if (st == TXN_TOTALS) {
+                ev |= txn_close(t, now_ms, out);   /* итог есть, нет только счётчиков */
+            }
+            return ev | txn_set_state(t, TXN_IDLE);
+
+        case GKL_TRK_NOZZLE_UP:
+            if (!fresh) break;
+            txn_start(t, now_ms);
+            ev |= txn_set_state(t, TXN_NOZZLE_UP);
+            break;
+
+        case GKL_TRK_AUTHORIZED:
+            if (fresh) txn_start(t, now_ms);
+            if (fresh || st == TXN_NOZZLE_UP) ev |= txn_set_state(t, TXN_AUTHORIZED);
+            break;
+
+        case GKL_TRK_FUELING:
+            if (fresh) txn_start(t, now_ms);
+            if (st <= TXN_AUTHORIZED || st == TXN_CLOSED) ev |= txn_set_state(t, TXN_FUELING);
+            break;
+
+        case GKL_TRK_FINISHED:
+            /* Из IDLE — контроллер перезапустился посреди налива: итог всё равно заберём */
+            if (st == TXN_CLOSED || st == TXN_FINISHED || st == TXN_TOTALS) break;
+            if (st == TXN_IDLE) txn_start(t, now_ms);
+            t->need = NEED_VOLUME | NEED_MONEY | (nozzle_num(nozzle) ? NEED_TOTALS : 0u);
+            ev |= txn_set_state(t, TXN_FINISHED);
+            break;
+
+        default:
+            break;
+    }
+    if (t->state != TXN_IDLE) t->nozzle = nozzle;
+    return ev;
+}
+
+uint32_t TRK_Txn_OnReply(trk_txn_t *t, const GKL_Reply *r, uint32_t now_ms, trk_txn_record_t *rec)
+{
+    uint32_t ev = 0;
+    if (!t || !r) return 0u;
+
+    switch (r->cmd)
+    {
+        case 'S':
+        case 'D':
+            return txn_on_status(t, r->u.status.status, r->u.status.nozzle, now_ms, rec);
+
+        case 'L':
+            if (t->state == TXN_IDLE || t->state == TXN_CLOSED) return 0u;
+            if (r->u.volume.volume_cl != t->volume_cl) ev |= TXN_EV_PROGRESS;
+            t->volume_cl = r->u.volume.volume_cl;
+            t->need &= (uint8_t)~NEED_VOLUME;
+            break;
+
+        case 'R':
+            if (t->state == TXN_IDLE || t->state == TXN_CLOSED) return 0u;
+            if (r->u.money.money_kop != t->money_kop) ev |= TXN_EV_PROGRESS;
+            t->money_kop = r->u.money.money_kop;
+            t->need &= (uint8_t)~NEED_MONEY;
+            break;
+
+        case 'Z':
+            /* Доза до снятия пистолета — тоже начало транзакции */
+            if (t->state == TXN_IDLE || t->state == TXN_CLOSED) {
+                txn_start(t, now_ms);
+                ev |= txn_set_state(t, TXN_AUTHORIZED);
+            }
+            t->preset = r->u.preset.dose;
+            t->flags |= TXN_REC_PRESET;
+            break;
+
+        case 'T':
+            if (t->state != TXN_TOTALS) return 0u;
+            t->totals_cl = r->u.totals.volume_cl;
+            t->flags |= TXN_REC_TOTALS;
+            t->need &= (uint8_t)~NEED_TOTALS;
+            break;
+
+        default:
+            return 0u;
+    }
+    return ev | txn_after_result(t, now_ms, rec);
+}
+
+gkl_cmd_id_t TRK_Txn_NextRequest(trk_txn_t *t, uint8_t *nozzle)
+{
+    /* Во время налива: S L S R — статус не реже раза в два запроса */
+    static const gkl_cmd_id_t fueling[4] = { GKL_CMD_STATUS, GKL_CMD_VOLUME, GKL_CMD_STATUS, GKL_CMD_MONEY };
+    uint8_t phase = t->poll_phase++;
+
+    switch ((trk_txn_state_t)t->state)
+    {
+        case TXN_FUELING:
+            return fueling[phase & 3u];
+
+        /* Дочитываем итог через раз со статусом: ТРК, не знающая команду,
+           не подвесит транзакцию — '0' в статусе её закроет */
+        case TXN_FINISHED:
+            if (phase & 1u) {
+                if (t->need & NEED_VOLUME) return GKL_CMD_VOLUME;
+                if (t->need & NEED_MONEY)  return GKL_CMD_MONEY;
+            }
+            return GKL_CMD_STATUS;
+
+        case TXN_TOTALS:
+            if ((phase & 1u) && (t->need & NEED_TOTALS)) {
+                if (nozzle) *nozzle = nozzle_num(t->nozzle);
+                return GKL_CMD_TOTALS;
+            }
+            return GKL_CMD_STATUS;
+
+        default:
+            return GKL_CMD_STATUS;
+    }
+}
@@ -0,0 +1,448 @@
+/* File: Core/Src/trk_uart.c */
+#include "trk_uart.h"
+#include <string.h>
+
+/*
+ * Буферы лежат в .bss (AXI SRAM, RAM_D1) — доступна для DMA1/DMA2.
+ * D-Cache в проекте не включён, поэтому обслуживание кэша не требуется.
+ */
+
+/* Индекс очереди разрывов — по маске, счётчики uint8_t */
+_Static_assert((TRK_UART_GAP_QUEUE_LEN & (TRK_UART_GAP_QUEUE_LEN - 1u)) == 0 &&
+               TRK_UART_GAP_QUEUE_LEN <= 128u, "gap queue must be a power of two");
+
+static trk_uart_t* s_ports[TRK_UART_MAX_PORTS];
+
+trk_uart_t* TRK_UART_FromHandle(UART_HandleTypeDef* huart)
+{
+    for (uint32_t i = 0; i < TRK_UART_MAX_PORTS; i++) {
+        if (s_ports[i] && s_ports[i]->huart == huart) return s_ports[i];
+    }
+    return NULL;
+}
+
+static void port_register(trk_uart_t* u)
+{
+    for (uint32_t i = 0; i < TRK_UART_MAX_PORTS; i++) {
+        if (s_ports[i] == u) return;
+        if (s_ports[i] == NULL) { s_ports[i] = u; return; }
+    }
+}
+
+static void rx_push(trk_uart_t* u, const uint8_t* src, uint32_t len)
+{
+    uint32_t written = spsc_ring_write(&u->rx_ring, src, len);
+    u->rx_bytes   += written;
+    u->rx_dropped += (len - written);
+    if (u->rx_cb) u->rx_cb(u->rx_ctx, src, len);
+}
+
+static HAL_StatusTypeDef dma_stream_init(DMA_HandleTypeDef* h, const trk_uart_dma_cfg_t* cfg,
+                                         uint32_t direction, uint32_t mode)
+{
+    h->Instance                 = cfg->stream;
+    h->Init.Request             = cfg->request;
+    h->Init.Direction           = direction;
+    h->Init.PeriphInc           = DMA_PINC_DISABLE;
+    h->Init.MemInc              = DMA_MINC_ENABLE;
+    h->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    h->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    h->Init.Mode                = mode;
+    h->Init.Priority            = DMA_PRIORITY_HIGH;
+    h->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(h) != HAL_OK) return HAL_ERROR;
+
+    /* Приоритет как у самого USART — события DMA и UART не вытесняют друг друга */
+    HAL_NVIC_SetPriority(cfg->irqn, 2, 0);
+    HAL_NVIC_EnableIRQ(cfg->irqn);
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef de_init(UART_HandleTypeDef* huart, const trk_uart_de_cfg_t* de)
+{
+    if (!IS_UART_DRIVER_ENABLE_INSTANCE(huart->Instance)) return HAL_ERROR;
+    if (de->assert_16 > 31u || de->deassert_16 > 31u) return HAL_ERROR;
+
+    /* Тактирование порта: GPIOA..K идут подряд через 0x400, биты AHB4ENR — так же */
+    SET_BIT(RCC->AHB4ENR, 1UL << (((uintptr_t)de->port - GPIOA_BASE) / 0x400u));
+    (void)READ_REG(RCC->AHB4ENR);
+
+    GPIO_InitTypeDef g = {0};
+    g.Pin       = de->pin;
+    g.Mode      = GPIO_MODE_AF_PP;
+    g.Pull      = GPIO_NOPULL;
+    g.Speed     = GPIO_SPEED_FREQ_LOW;
+    g.Alternate = de->af;
+    HAL_GPIO_Init(de->port, &g);
+
+    __HAL_UART_DISABLE(huart);
+    MODIFY_REG(huart->Instance->CR3, USART_CR3_DEM | USART_CR3_DEP,
+               USART_CR3_DEM | (de->active_low ? USART_CR3_DEP : 0u));
+    MODIFY_REG(huart->Instance->CR1, USART_CR1_DEAT | USART_CR1_DEDT,
+               ((uint32_t)de->assert_16 << USART_CR1_DEAT_Pos) |
+               ((uint32_t)de->deassert_16 << USART_CR1_DEDT_Pos));
+    __HAL_UART_ENABLE(huart);
+
+    /* Как UART_CheckIdleState: передатчик и приёмник снова подтвердили включение */
+    uint32_t t0 = HAL_GetTick();
+    uint32_t ack = USART_ISR_TEACK | USART_ISR_REACK;
+    while ((huart->Instance->ISR & ack) != ack) {
+        if ((HAL_GetTick() - t0) > 10u) return HAL_TIMEOUT;
+    }
+    return HAL_OK;
+}
+
+/* Запуск следующего кадра из очереди. Вызывать из ISR или при запрещённых прерываниях. */
+static void tx_kick(trk_uart_t* u)
+{
+    if (u->tx_busy || u->tx_head == u->tx_tail) return;
+
+    trk_uart_tx_slot_t* slot = &u->tx_q[u->tx_tail & (TRK_UART_TX_QUEUE_LEN - 1u)];
+    u->tx_busy = 1u;
+    /* HAL не пишет в буфер передачи — снимать const безопасно */
+    uint8_t* src = slot->ext ? (uint8_t*)(uintptr_t)slot->ext : slot->data;
+    if (HAL_UART_Transmit_DMA(u->huart, src, slot->len) != HAL_OK) {
+        /* Кадр выбрасываем, чтобы очередь не встала навсегда */
+        u->tx_busy = 0u;
+        u->tx_tail++;
+        u->tx_dropped++;
+    }
+}
+
+HAL_StatusTypeDef TRK_UART_Init(trk_uart_t* u, UART_HandleTypeDef* huart,
+                                const trk_uart_dma_cfg_t* rx_dma,
+                                const trk_uart_dma_cfg_t* tx_dma,
+                                const trk_uart_de_cfg_t* de)
+{
+    if (!u || !huart || !rx_dma || !tx_dma) return HAL_ERROR;
+
+    u->huart      = huart;
+    u->dma_rx_pos = 0;
+    u->rx_events  = 0;
+    u->rx_bytes   = 0;
+    u->rx_dropped = 0;
+    spsc_ring_init(&u->rx_ring, u->ring_storage, TRK_UART_RING_SIZE);
+
+    u->tx_head    = 0;
+    u->tx_tail    = 0;
+    u->tx_busy    = 0;
+    u->tx_frames  = 0;
+    u->tx_bytes   = 0;
+    u->tx_dropped = 0;
+
+    u->gap_head    = 0;
+    u->gap_tail    = 0;
+    u->rx_gaps     = 0;
+    u->last_gap_ms = 0;
+    port_register(u);
+
+    /* Счётчик тактов для меток времени; если уже запущен (u8g2) — не сбрасываем */
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0u) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    if (de && de->port && de_init(huart, de) != HAL_OK) return HAL_ERROR;
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    if (dma_stream_init(&u->hdma_rx, rx_dma, DMA_PERIPH_TO_MEMORY, DMA_CIRCULAR) != HAL_OK)
+        return HAL_ERROR;
+    __HAL_LINKDMA(huart, hdmarx, u->hdma_rx);
+
+    if (dma_stream_init(&u->hdma_tx, tx_dma, DMA_MEMORY_TO_PERIPH, DMA_NORMAL) != HAL_OK)
+        return HAL_ERROR;
+    __HAL_LINKDMA(huart, hdmatx, u->hdma_tx);
+
+    /* Кольцевой DMA + IDLE: колбэк RxEvent приходит на HT, TC и паузу в линии */
+    return HAL_UARTEx_ReceiveToIdle_DMA(huart, u->dma_rx_buf, TRK_UART_DMA_RX_SIZE);
+}
+
+void TRK_UART_OnRxEvent(trk_uart_t* u, uint16_t pos)
+{
+    uint16_t old = u->dma_rx_pos;
+    u->rx_events++;
+
+    if (pos > TRK_UART_DMA_RX_SIZE) return; /* защита от мусорного Size */
+    if (pos != old) u->last_rx_cyc = TRK_UART_Cycles();
+
+    if (pos > old) {
+        rx_push(u, &u->dma_rx_buf[old], (uint32_t)(pos - old));
+    } else if (pos < old) {
+        /* DMA перешёл через конец буфера */
+        rx_push(u, &u->dma_rx_buf[old], (uint32_t)(TRK_UART_DMA_RX_SIZE - old));
+        rx_push(u, &u->dma_rx_buf[0], pos);
+    }
+
+    u->dma_rx_pos = (pos == TRK_UART_DMA_RX_SIZE) ? 0u : pos;
+}
+
+void TRK_UART_SetTxDoneCallback(trk_uart_t* u, trk_uart_tx_done_cb_t cb, void* ctx)
+{
+    if (!u) return;
+    u->tx_done_cb  = cb;
+    u->tx_done_ctx = ctx;
+}
+
+void TRK_UART_SetRxCallbacks(trk_uart_t* u, trk_uart_rx_cb_t on_bytes,
+                             trk_uart_gap_cb_t on_gap, trk_uart_err_cb_t on_error, void* ctx)
+{
+    if (!u) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    u->rx_cb  = on_bytes;
+    u->gap_cb = on_gap;
+    u->err_cb = on_error;
+    u->rx_ctx = ctx;
+    __set_PRIMASK(primask);
+}
+
+static bool tx_enqueue(trk_uart_t* u, const uint8_t* frame, size_t len, bool copy)
+{
+    if (!u || !frame || len == 0 || len > TRK_UART_TX_FRAME_MAX) return false;
+
+    /* Единственный писатель head — главный цикл */
+    if ((uint8_t)(u->tx_head - u->tx_tail) >= TRK_UART_TX_QUEUE_LEN) {
+        u->tx_dropped++;
+        return false;
+    }
+    trk_uart_tx_slot_t* slot = &u->tx_q[u->tx_head & (TRK_UART_TX_QUEUE_LEN - 1u)];
+    if (copy) {
+        memcpy(slot->data, frame, len);
+        slot->ext = NULL;
+    } else {
+        slot->ext = frame;
+    }
+    slot->len = (uint8_t)len;
+    __DMB();
+    u->tx_head++;
+
+    /* tx_busy/tail меняет и ISR — стартуем под запретом прерываний */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tx_kick(u);
+    __set_PRIMASK(primask);
+    return true;
+}
+
+bool TRK_UART_Send(trk_uart_t* u, const uint8_t* frame, size_t len)
+{
+    return tx_enqueue(u, frame, len, true);
+}
+
+bool TRK_UART_SendConst(trk_uart_t* u, const uint8_t* frame, size_t len)
+{
+    return tx_enqueue(u, frame, len, false);
+}
+
+void TRK_UART_OnTxComplete(trk_uart_t* u)
+{
+    u->tx_bytes += u->tx_q[u->tx_tail & (TRK_UART_TX_QUEUE_LEN - 1u)].len;
+    u->tx_tail++;
+    u->tx_busy = 0u;
+    u->tx_frames++;
+    u->tx_done_cyc = TRK_UART_Cycles();
+
+    if (u->tx_done_cb) u->tx_done_cb(u->tx_done_ctx);
+
+    tx_kick(u);
+}
+
+size_t TRK_UART_Read(trk_uart_t* u, uint8_t* dst, size_t max)
+{
+    if (!u || !dst || max == 0) return 0;
+    return spsc_ring_read(&u->rx_ring, dst, (uint32_t)max);
+}
+
+HAL_StatusTypeDef TRK_UART_EnableGapDetect(trk_uart_t* u, uint32_t gap_bits)
+{
+    if (!u || !u->huart || gap_bits == 0 || gap_bits > USART_RTOR_RTO) return HAL_ERROR;
+
+    HAL_UART_ReceiverTimeout_Config(u->huart, gap_bits);
+    if (HAL_UART_EnableReceiverTimeout(u->huart) != HAL_OK) return HAL_ERROR;
+    __HAL_UART_CLEAR_FLAG(u->huart, UART_CLEAR_RTOF);
+    ATOMIC_SET_BIT(u->huart->Instance->CR1, USART_CR1_RTOIE);
+    return HAL_OK;
+}
+
+size_t TRK_UART_ReadUntilGap(trk_uart_t* u, uint8_t* dst, size_t max, bool* gap)
+{
+    if (gap) *gap = false;
+    if (!u || !dst || max == 0) return 0;
+
+    if (u->gap_tail != u->gap_head) {
+        __DMB();
+        uint32_t mark  = u->gap_pos[u->gap_tail & (TRK_UART_GAP_QUEUE_LEN - 1u)];
+        uint32_t until = mark - u->rx_ring.tail;   /* байт до отметки */
+        if (until <= max) {
+            size_t n = spsc_ring_read(&u->rx_ring, dst, until);
+            u->gap_tail++;
+            if (gap) *gap = true;
+            return n;
+        }
+    }
+    return spsc_ring_read(&u->rx_ring, dst, (uint32_t)max);
+}
+
+/* Досливает из DMA то, что пришло после последнего IDLE/HT/TC */
+static void rx_flush_dma(trk_uart_t* u)
+{
+    if (u->huart->hdmarx) {
+        uint16_t pos = (uint16_t)(TRK_UART_DMA_RX_SIZE - __HAL_DMA_GET_COUNTER(u->huart->hdmarx));
+        TRK_UART_OnRxEvent(u, pos);
+    }
+}
+
+static void rx_gap(trk_uart_t* u)
+{
+    /* Отметка разрыва должна встать строго после последнего байта */
+    rx_flush_dma(u);
+
+    u->rx_gaps++;
+    u->last_gap_ms = HAL_GetTick();
+    if ((uint8_t)(u->gap_head - u->gap_tail) < TRK_UART_GAP_QUEUE_LEN) {
+        u->gap_pos[u->gap_head & (TRK_UART_GAP_QUEUE_LEN - 1u)] = u->rx_ring.head;
+        __DMB();
+        u->gap_head++;
+    } else {
+        u->gaps_dropped++;
+    }
+    if (u->gap_cb) u->gap_cb(u->rx_ctx);
+}
+
+/* Ошибка приёма (ISR): байты до неё — в кольцо и разборщику, потом сброс его кадра */
+static void rx_error(trk_uart_t* u, uint32_t errors)
+{
+    if (errors & HAL_UART_ERROR_ORE) u->err_ore++;
+    if (errors & HAL_UART_ERROR_FE)  u->err_fe++;
+    if (errors & HAL_UART_ERROR_NE)  u->err_ne++;
+    if (errors & HAL_UART_ERROR_PE)  u->err_pe++;
+    if (errors & HAL_UART_ERROR_DMA) u->err_dma++;
+
+    rx_flush_dma(u);
+    if (u->err_cb) u->err_cb(u->rx_ctx, errors);
+}
+
+/* Кольцевой приём стоит: HAL после ошибки закрыл его (RxState READY)
+   или поток DMA выключен. Досливаем, что успело прийти, и запускаем заново. */
+static void rx_rearm_if_stopped(trk_uart_t* u)
+{
+    UART_HandleTypeDef* huart = u->huart;
+    bool dma_on = huart->hdmarx && (((DMA_Stream_TypeDef*)huart->hdmarx->Instance)->CR & DMA_SxCR_EN);
+    if (huart->RxState == HAL_UART_STATE_BUSY_RX && dma_on) return;
+
+    if (huart->RxState == HAL_UART_STATE_BUSY_RX) {
+        HAL_UART_AbortReceive(huart);
+    }
+    __HAL_UART_CLEAR_FLAG(huart, UART_CLEAR_OREF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_PEF);
+    u->dma_rx_pos = 0;
+    if (HAL_UARTEx_ReceiveToIdle_DMA(huart, u->dma_rx_buf, TRK_UART_DMA_RX_SIZE) == HAL_OK) {
+        u->rx_rearms++;
+    }
+}
+
+void TRK_UART_OnError(trk_uart_t* u)
+{
+    if (!u) return;
+    rx_error(u, HAL_UART_GetError(u->huart));
+    rx_rearm_if_stopped(u);
+}
+
+void TRK_UART_CheckRx(trk_uart_t* u)
+{
+    if (!u || !u->huart) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    rx_rearm_if_stopped(u);
+    __set_PRIMASK(primask);
+}
+
+void TRK_UART_IRQPreHandler(UART_HandleTypeDef* huart)
+{
+    uint32_t isr = huart->Instance->ISR;
+    if ((isr & USART_ISR_RTOF) == 0u || (huart->Instance->CR1 & USART_CR1_RTOIE) == 0u) return;
+
+    __HAL_UART_CLEAR_FLAG(huart, UART_CLEAR_RTOF);
+
+    trk_uart_t* u = TRK_UART_FromHandle(huart);
+    if (u) rx_gap(u);
+}
+
+#if TRK_UART_LEAN_ISR
+/* Всё, что может включить транспорт: ошибки (EIE/PEIE), RTOIE, IDLEIE, TCIE.
+   RXNE не используется — байты забирает DMA. */
+static void lean_irq(trk_uart_t* u)
+{
+    USART_TypeDef* uart = u->huart->Instance;
+    uint32_t isr = uart->ISR;
+    uint32_t cr1 = uart->CR1;
+
+    uint32_t err = isr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE);
+    if (err) {
+        /* Байт уже потерян или испорчен; DMA не останавливаем — поток идёт дальше */
+        uart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NECF | USART_ICR_PECF;
+        rx_error(u, ((err & USART_ISR_ORE) ? HAL_UART_ERROR_ORE : 0u) |
+                    ((err & USART_ISR_FE)  ? HAL_UART_ERROR_FE  : 0u) |
+                    ((err & USART_ISR_NE)  ? HAL_UART_ERROR_NE  : 0u) |
+                    ((err & USART_ISR_PE)  ? HAL_UART_ERROR_PE  : 0u));
+    }
+
+    if ((isr & USART_ISR_IDLE) && (cr1 & USART_CR1_IDLEIE)) {
+        uart->ICR = USART_ICR_IDLECF;
+        rx_flush_dma(u);
+    }
+
+    if ((isr & USART_ISR_RTOF) && (cr1 & USART_CR1_RTOIE)) {
+        uart->ICR = USART_ICR_RTOCF;
+        rx_gap(u);
+    }
+
+    if ((isr & USART_ISR_TC) && (cr1 & USART_CR1_TCIE)) {
+        /* То же, что UART_EndTransmit_IT: HAL должен увидеть передатчик свободным */
+        ATOMIC_CLEAR_BIT(uart->CR1, USART_CR1_TCIE);
+        u->huart->gState = HAL_UART_STATE_READY;
+        u->huart->TxISR  = NULL;
+        TRK_UART_OnTxComplete(u);
+    }
+}
+#endif
+
+bool TRK_UART_IRQHandler(UART_HandleTypeDef* huart)
+{
+    trk_uart_t* u = TRK_UART_FromHandle(huart);
+    if (!u) return false;
+
+    uint32_t t0 = TRK_UART_Cycles();
+#if TRK_UART_LEAN_ISR
+    lean_irq(u);
+#else
+    TRK_UART_IRQPreHandler(huart);
+    HAL_UART_IRQHandler(huart);
+#endif
+    uint32_t dt = TRK_UART_Cycles() - t0;
+    u->isr_calls++;
+    u->isr_cyc_sum += dt;
+    if (dt > u->isr_cyc_max) u->isr_cyc_max = dt;
+    return true;
+}
+
+void TRK_UART_DMA_IRQHandler(DMA_Stream_TypeDef* stream)
+{
+    for (uint32_t i = 0; i < TRK_UART_MAX_PORTS; i++) {
+        trk_uart_t* u = s_ports[i];
+        if (!u) continue;
+        if (u->hdma_rx.Instance == stream) { HAL_DMA_IRQHandler(&u->hdma_rx); return; }
+        if (u->hdma_tx.Instance == stream) { HAL_DMA_IRQHandler(&u->hdma_tx); return; }
+    }
+}
+
+/* =========================
+ *  Колбэки HAL для зарегистрированных портов
+ * ========================= */
+/* HT/TC кольцевого DMA или IDLE в линии — перекладываем новые байты в кольцо порта */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    trk_uart_t* u = TRK_UART_FromHandle(huart);
+    if (u) TRK_UART_OnRxEvent(u, Size);
+}
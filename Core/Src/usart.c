@@ -21,7 +21,32 @@
 #include "usart.h"
 
 /* USER CODE BEGIN 0 */
-
+/*
+ * CubeMX генерирует DisableFifoMode; режим FIFO включаем в USER CODE Init 2,
+ * чтобы перегенерация его не снесла.
+ *  - Логи (USART1/2): вывод HAL_UART_Transmit_IT. Порог TX 3/4 — прерывание,
+ *    когда в FIFO освободилось 12 мест, и HAL докладывает 12 байт за раз
+ *    (4 байта в запасе ≈ 350 мкс при 115200 на вход в ISR).
+ *  - ТРК (USART3/6): байты носит DMA (запрос по RXFNE/TXFNF, порог на DMA
+ *    не влияет), FIFO даёт 16 байт запаса на задержку DMA. Дослив хвоста —
+ *    по IDLE и по таймауту приёма (RTOF), см. trk_uart.c. Порог RX 1/8 —
+ *    на случай приёма по прерываниям.
+ */
+static void UART_EnableFifo(UART_HandleTypeDef *huart, uint32_t tx_threshold, uint32_t rx_threshold)
+{
+  if (HAL_UARTEx_SetTxFifoThreshold(huart, tx_threshold) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_UARTEx_SetRxFifoThreshold(huart, rx_threshold) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_UARTEx_EnableFifoMode(huart) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
 /* USER CODE END 0 */
 
 UART_HandleTypeDef huart1;
@@ -69,7 +94,7 @@ void MX_USART1_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART1_Init 2 */
-
+  UART_EnableFifo(&huart1, UART_TXFIFO_THRESHOLD_3_4, UART_RXFIFO_THRESHOLD_1_8);
   /* USER CODE END USART1_Init 2 */
 
 }
@@ -113,7 +138,7 @@ void MX_USART2_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART2_Init 2 */
-
+  UART_EnableFifo(&huart2, UART_TXFIFO_THRESHOLD_3_4, UART_RXFIFO_THRESHOLD_1_8);
   /* USER CODE END USART2_Init 2 */
 
 }
@@ -157,7 +182,7 @@ void MX_USART3_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART3_Init 2 */
-
+  UART_EnableFifo(&huart3, UART_TXFIFO_THRESHOLD_1_8, UART_RXFIFO_THRESHOLD_1_8);
   /* USER CODE END USART3_Init 2 */
 
 }
@@ -201,7 +226,7 @@ void MX_USART6_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART6_Init 2 */
-
+  UART_EnableFifo(&huart6, UART_TXFIFO_THRESHOLD_1_8, UART_RXFIFO_THRESHOLD_1_8);
   /* USER CODE END USART6_Init 2 */
 
 }
@@ -0,0 +1,110 @@
+/*
+ * Хост-бенчмарк парсера GKL: побайтный GKL_Parser_ConsumeByte против
+ * GKL_Parser_ConsumeBuffer на одном и том же потоке, порезанном на куски
+ * как кольцевой DMA. Размер куска — аргумент (по умолчанию 32 байта —
+ * половина TRK_UART_DMA_RX_SIZE).
+ *
+ * Сборка и запуск из корня репозитория:
+ *   gcc -O2 -ICore/Inc Tools/gkl_parser_bench/gkl_parser_bench.c \
+ *       Core/Src/gkl_parser.c Core/Src/gkl_frame.c Core/Src/gkl_decode.c -o gkl_parser_bench
+ *   ./gkl_parser_bench [chunk]
+ */
+#include "gkl_parser.h"
+#include "gkl_frame.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_SIZE   (4u * 1024u * 1024u)
+#define CHUNK_DEFAULT 32u
+#define ROUNDS        10
+
+static uint8_t s_stream[STREAM_SIZE];
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Смесь ответов, как на живой линии, плюс изредка шум и битый байт */
+static size_t build_stream(void)
+{
+    static const struct { uint8_t cmd; const char* data; } replies[] = {
+        { 'S', "31" },
+        { 'L', "113;001234" },
+        { 'R', "113;004567" },
+        { 'T', "1;0000123456;000009999" },
+        { 'C', "1;004599;92" },
+    };
+    size_t n = 0;
+    unsigned seed = 1;
+
+    while (n + 64 < STREAM_SIZE) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned k = (seed >> 16) % (sizeof(replies) / sizeof(replies[0]));
+        size_t len = gkl_build_frame((uint8_t)(1 + (seed >> 8) % 32), replies[k].cmd,
+                                     (const uint8_t*)replies[k].data, strlen(replies[k].data),
+                                     &s_stream[n], STREAM_SIZE - n);
+        if ((seed >> 4) % 64 == 0) s_stream[n + len / 2] ^= 0x10; /* битый кадр */
+        n += len;
+        if ((seed >> 6) % 32 == 0) s_stream[n++] = 0x02;          /* шум, похожий на SYN */
+    }
+    return n;
+}
+
+static void count_frame(void* ctx, const GKL_Frame* frame)
+{
+    (void)frame;
+    (*(size_t*)ctx)++;
+}
+
+int main(int argc, char** argv)
+{
+    size_t chunk = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : CHUNK_DEFAULT;
+    if (chunk == 0) {
+        fprintf(stderr, "usage: %s [chunk]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t len = build_stream();
+    GKL_ParserState p;
+    size_t frames_byte = 0, frames_buf = 0;
+    uint32_t stats_byte = 0, stats_buf = 0;
+
+    double t0 = now_sec();
+    for (int r = 0; r < ROUNDS; r++) {
+        GKL_Parser_Init(&p);
+        frames_byte = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (GKL_Parser_ConsumeByte(&p, s_stream[i]) == PARSE_SUCCESS) frames_byte++;
+        }
+        stats_byte = p.stats.frames;
+    }
+    double t_byte = now_sec() - t0;
+
+    t0 = now_sec();
+    for (int r = 0; r < ROUNDS; r++) {
+        GKL_Parser_Init(&p);
+        frames_buf = 0;
+        for (size_t i = 0; i < len; i += chunk) {
+            size_t n = (len - i < chunk) ? len - i : chunk;
+            GKL_Parser_ConsumeBuffer(&p, &s_stream[i], n, count_frame, &frames_buf);
+        }
+        stats_buf = p.stats.frames;
+    }
+    double t_buf = now_sec() - t0;
+
+    double mb = (double)len * ROUNDS / (1024.0 * 1024.0);
+    printf("stream %zu bytes x %d, chunk %zu\n", len, ROUNDS, chunk);
+    printf("ConsumeByte   : %8.1f MB/s  frames=%zu (stats %lu)\n", mb / t_byte, frames_byte,
+           (unsigned long)stats_byte);
+    printf("ConsumeBuffer : %8.1f MB/s  frames=%zu (stats %lu)\n", mb / t_buf, frames_buf,
+           (unsigned long)stats_buf);
+    printf("speedup       : %8.2fx\n", t_byte / t_buf);
+    /* Каждый разобранный кадр должен дойти до вызывающего, и оба пути — увидеть одни и те же */
+    bool ok = frames_byte == frames_buf && frames_byte == stats_byte && frames_buf == stats_buf;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}